@@ -1,967 +1,3765 @@
-#include <iostream>         // cout, cerr
-#include <cstdlib>          // EXIT_FAILURE
-#include <vector>           // Vector for list-like features
-#include <cmath>
-
-// GLM Math Header inclusions
-#include <glm/glm.hpp>
-#include <glm/gtx/transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-
-#include <GL/glew.h>        // GLEW library
-#include <GLFW/glfw3.h>     // GLFW library
-#include <camera.h>         // Camera Implementation
-
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>      // Image loading Utility functions
-
-using namespace std;        // Standard Namespace
-
-/*Shader program Macro*/
-#ifndef GLSL
-#define GLSL(Version, Source) "#version " #Version " core \n" #Source
-#endif
-
-// WINDOW CONSTS
-const char* const WINDOW_TITLE = "Assignment 7-1";
-const int WINDOW_WIDTH = 800;
-const int WINDOW_HEIGHT = 600;
-
-struct GLMesh // Mesh Data
-{
-    GLuint vao;           // Handle for the vertex array object
-    GLuint vbo;           // Handle for the vertex buffer object
-    GLuint nVertices;     // Number of indices of the mesh
-    GLuint textureId;     // Image for mesh
-};
-
-GLFWwindow* gWindow = nullptr; // Main GLFW window
-vector<GLMesh> gMeshVector; // Vector of all the meshes
-
-// Texture
-glm::vec2 gUVScale(1.0f, 1.0f);
-GLint gTexWrapMode = GL_REPEAT;
-
-// Shader Programs
-GLuint gMeshProgramId; // Mesh Shader Id
-GLuint gLightProgramId; // Light Shader Id
-
-// Mesh Color
-glm::vec3 gObjectColor(1.f, 0.2f, 0.0f);
-glm::vec3 gLightColor(1.0f, 1.0f, 1.0f);
-
-// Light position and scale
-glm::vec3 gLightPosition(0.0f, 2.0f, 3.0f);
-
-// Camera
-glm::vec3 gCameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
-glm::vec3 gCameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
-glm::vec3 gCameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
-Camera gCamera(glm::vec3(0.0f, 0.0f, 3.0f));
-float gLastX = WINDOW_WIDTH / 2.0f;
-float gLastY = WINDOW_HEIGHT / 2.0f;
-bool gFirstMouse = true;
-
-bool gIsPPressed = false; // Prevents double-tapping P
-
-// Time
-float gDeltaTime = 0.0f; // time between current frame and last frame
-float gLastFrame = 0.0f;
-
-/* User-defined Function prototypes to:
- * initialize the program, set the window size,
- * redraw graphics on the window when resized,
- * and render graphics on the screen
- */
-void addCounter(int& current, int max, int increment);
-bool createTexture(const char* filename, GLuint& textureId);
-void flipImageVertically(unsigned char* image, int width, int height, int channels);
-bool UInitialize(int, char* [], GLFWwindow** window);
-void UResizeWindow(GLFWwindow* window, int width, int height);
-void UProcessInput(GLFWwindow* window);
-void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos);
-void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
-void UCreateCube(float x, float y, float z, float w, float h, float l, const char* filename);
-void UCreateCylinder(float x, float y, float z, float r, float h, const char* filename);
-void UCreatePlane(
-    float x1, float y1, float z1, 
-    float x2, float y2, float z2,
-    float x3, float y3, float z3,
-    float x4, float y4, float z4, const char* filename
-);
-void UCreatePyramid(float x, float y, float z, float w, float h, float l, const char* filename);
-void UDestroyMesh();
-void UDestroyTexture();
-void URender();
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
-void UDestroyShaderProgram();
-
-/* Cube Vertex Shader Source Code*/
-const GLchar* meshVertexShaderSource = GLSL(440,
-	layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
-	layout(location = 1) in vec3 normal; // VAP position 1 for normals
-	layout(location = 2) in vec2 textureCoordinate;
-
-	out vec3 vertexNormal; // For outgoing normals to fragment shader
-	out vec3 vertexFragmentPos; // For outgoing color / pixels to fragment shader
-	out vec2 vertexTextureCoordinate;
-
-	//Uniform / Global variables for the  transform matrices
-	uniform mat4 model;
-	uniform mat4 view;
-	uniform mat4 projection;
-
-	void main()
-	{
-	    gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
-
-	    vertexFragmentPos = vec3(model * vec4(position, 1.0f)); // Gets fragment / pixel position in world space only (exclude view and projection)
-
-	    vertexNormal = mat3(transpose(inverse(model))) * normal; // get normal vectors in world space only and exclude normal translation properties
-	    vertexTextureCoordinate = textureCoordinate;
-	}
-);
-
-/* Cube Fragment Shader Source Code*/
-const GLchar* meshFragmentShaderSource = GLSL(440,
-    in vec3 vertexNormal; // For incoming normals
-	in vec3 vertexFragmentPos; // For incoming fragment position
-	in vec2 vertexTextureCoordinate;
-	out vec4 fragmentColor; // For outgoing cube color to the GPU
-
-	// Uniform / Global variables for object color, light color, light position, and camera/view position
-	uniform vec3 objectColor;
-	uniform vec3 lightColor;
-	uniform vec3 lightPos;
-	uniform vec3 viewPosition;
-	uniform sampler2D uTexture; // Useful when working with multiple textures
-	uniform vec2 uvScale;
-
-	void main()
-	{
-	    /*Phong lighting model calculations to generate ambient, diffuse, and specular components*/
-
-	    //Calculate Ambient lighting*/
-	    float ambientStrength = .4f; // Set ambient or global lighting strength
-	    vec3 ambient = ambientStrength * lightColor; // Generate ambient light color
-
-	    //Calculate Diffuse lighting*/
-	    vec3 norm = normalize(vertexNormal); // Normalize vectors to 1 unit
-	    vec3 lightDirection = normalize(lightPos - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
-	    float impact = max(dot(norm, lightDirection), 0.0);// Calculate diffuse impact by generating dot product of normal and light
-	    vec3 diffuse = impact * lightColor; // Generate diffuse light color
-
-	    //Calculate Specular lighting*/
-	    float specularIntensity = 0.8f; // Set specular light strength
-	    float highlightSize = 16.0f; // Set specular highlight size
-	    vec3 viewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
-	    vec3 reflectDir = reflect(-lightDirection, norm);// Calculate reflection vector
-	    //Calculate specular component
-	    float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), highlightSize);
-	    vec3 specular = specularIntensity * specularComponent * lightColor;
-
-	    // Texture holds the color to be used for all three components
-	    vec4 textureColor = texture(uTexture, vertexTextureCoordinate * uvScale);
-
-	    // Calculate phong result
-	    vec3 phong = (ambient + diffuse + specular) * textureColor.xyz;
-
-	    fragmentColor = vec4(phong, 1.0); // Send lighting results to GPU
-	}
-);
-
-/* Lamp Shader Source Code*/
-const GLchar* lightVertexShaderSource = GLSL(440,
-    layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
-
-    //Uniform / Global variables for the  transform matrices
-	uniform mat4 model;
-	uniform mat4 view;
-	uniform mat4 projection;
-
-	void main()
-	{
-	    gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
-	}
-);
-
-/* Fragment Shader Source Code*/
-const GLchar* lightFragmentShaderSource = GLSL(440,
-    out vec4 fragmentColor; // For outgoing lamp color (smaller cube) to the GPU
-
-	void main()
-	{
-	    fragmentColor = vec4(1.0f); // Set color to white (1.0f,1.0f,1.0f) with alpha 1.0
-	}
-);
-
-/*Counts a counter and resets to 0 on overlap*/
-void addCounter(int& current, int max, int increment = 0)
-{
-    current += increment;
-    if (current > max)
-        current -= max;
-    if (current < 0)
-        current += max;
-}
-
-/*Generate and load the texture*/
-bool createTexture(const char* filename, GLuint& textureId)
-{
-    int width, height, channels;
-    unsigned char* image = stbi_load(filename, &width, &height, &channels, 0);
-    if (image)
-    {
-        flipImageVertically(image, width, height, channels);
-
-        glGenTextures(1, &textureId);
-        glBindTexture(GL_TEXTURE_2D, textureId);
-
-        // set the texture wrapping parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        // set texture filtering parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        if (channels == 3)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-        else if (channels == 4)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-        else
-        {
-            cout << "Not implemented to handle image with " << channels << " channels" << endl;
-            return false;
-        }
-
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        stbi_image_free(image);
-        glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
-
-        return true;
-    }
-
-    // Error loading the image
-    return false;
-}
-
-// Images are loaded with Y axis going down, but OpenGL's Y axis goes up, so let's flip it
-void flipImageVertically(unsigned char* image, int width, int height, int channels)
-{
-    for (int j = 0; j < height / 2; ++j)
-    {
-        int index1 = j * width * channels;
-        int index2 = (height - 1 - j) * width * channels;
-
-        for (int i = width * channels; i > 0; --i)
-        {
-            unsigned char tmp = image[index1];
-            image[index1] = image[index2];
-            image[index2] = tmp;
-            ++index1;
-            ++index2;
-        }
-    }
-}
-
-int main(int argc, char* argv[])
-{
-    if (!UInitialize(argc, argv, &gWindow))
-        return EXIT_FAILURE;
-
-    // Create the meshs
-
-    // Desk
-    const char * woodFilePath = "resources/Balsa_Wood_Texture.jpg";
-    const char * hardwoodFilePath = "resources/hardwood.jpg";
-    const char* paperFilePath = "resources/Free_crumpled_paper_texture_for_layers_(2978651767).jpg";
-    UCreateCube(0.0f, 0.0f, 0.0f, 0.9f, 0.1f, 0.9f, woodFilePath);  // flat desktop
-    UCreateCube(1.0f, 0.0f, 0.0f, 0.1f, 1.2f, 1.0f, woodFilePath);  // left wall
-    UCreateCube(0.0f, 0.0f, 1.0f, 1.1f, 1.2f, .1f, woodFilePath);   // back wall
-    UCreateCube(-1.0f, 0.0f, 0.0f, 0.1f, 1.2f, 1.0f, woodFilePath); // right wall
-    UCreatePlane(1.11f, 0.0f, 0.6f, 1.11f, 0.0f, 0.8f, 1.11f, -0.4f, 0.8f, 1.11f, -0.4f, 0.6f, hardwoodFilePath); // handle
-    UCreatePlane(-.89f, 0.8f, 0.0f,-.89f, 0.8f, 0.5f,-.89f, 0.3, 0.5f,-.89f, 0.3, 0.0f, paperFilePath); // paper on desk
-
-    // Room
-    const char* floorFilePath = "resources/black-and-white.jpg";
-    UCreatePlane(10.0f, -1.0f, -10.0f, -10.0f, -1.0f, -10.0f, -10.0f, -1.0f, 10.0f, 10.0f, -1.0f, 10.0f, floorFilePath); // paper on desk
-
-    // Trashcan
-    const char* trashcanFilePath = "resources/blue-leather.jpg";
-    glm::vec3 tPos = glm::vec3(1.4, -.95, 0);
-    UCreateCube(0.0f + tPos.x, 0.0f + tPos.y, 0.0f + tPos.z, 0.2f, 0.05f, 0.4f, trashcanFilePath);  // bottom
-    UCreateCube(-0.15f + tPos.x, 0.45f + tPos.y, 0.0f + tPos.z, 0.05f, 0.4f, 0.4f, trashcanFilePath);  // left
-    UCreateCube(0.15f + tPos.x, 0.45f + tPos.y, 0.0f + tPos.z, 0.05f, 0.4f, 0.4f, trashcanFilePath);  // right
-    UCreateCube(0.0f + tPos.x, 0.45f + tPos.y, .35f + tPos.z, 0.1f, 0.4f, 0.05f, trashcanFilePath);  // front
-    UCreateCube(0.0f + tPos.x, 0.45f + tPos.y, -.35f + tPos.z, 0.1f, 0.4f, 0.05f, trashcanFilePath);  // back
-
-    // Chair
-    const char* metalFilePath = "resources/metal.jpg";
-    const char* chairFilePath = "resources/texture-floor-asphalt-pattern-line-brown-1270308-pxhere.com.jpg";
-    glm::vec3 cPos = glm::vec3(0.0f, -0.4f, -1.5f);
-    UCreateCylinder(0.0f + cPos.x, -0.3f + cPos.y, 0.0f + cPos.z, 0.1f, 0.4f, metalFilePath);  // seat leg
-    UCreateCube(0.0f + cPos.x, -0.55f + cPos.y, 0.0f + cPos.z, 0.5f, 0.05f, 0.1f, metalFilePath);  // seat leg x
-    UCreateCube(0.0f + cPos.x, -0.55f + cPos.y, 0.0f + cPos.z, 0.1f, 0.05f, 0.5f, metalFilePath);  // seat leg z
-    UCreateCube(0.0f + cPos.x, 0.0f + cPos.y, 0.0f + cPos.z, 0.5f, 0.1f, 0.5f, chairFilePath);  // seat
-    UCreateCylinder(-0.2f + cPos.x, 0.3f + cPos.y, -0.4f + cPos.z, 0.05f, 0.4f, metalFilePath);  // back leg
-    UCreateCylinder(0.2f + cPos.x, 0.3f + cPos.y, -0.4f + cPos.z, 0.05f, 0.4f, metalFilePath);  // back leg 2
-    UCreateCube(0.0f + cPos.x, 0.9f + cPos.y, -0.4f + cPos.z, 0.5f, 0.4f, 0.1f, chairFilePath);  // back
-
-    // Computer
-    UCreatePlane(-0.4f, 0.11f, 0.0f, -0.8f, 0.11f, 0.0f, -0.8f, 0.11f, -0.4f, -0.4f, 0.11f, -0.4f, trashcanFilePath); // mousepad
-    UCreatePyramid(-0.6f, 0.15f, -0.2f, 0.075f, 0.05f, 0.125f, chairFilePath);  // mouse
-    UCreateCube(0.2f, 0.1f, -0.3f, 0.4f, 0.025f, 0.2f, chairFilePath);  // keyboard
-    UCreateCube(0.2f, 0.4f, 0.1f, 0.3f, 0.3f, 0.1f, chairFilePath);  // computer
-
-	// Create the shader program
-    if (!UCreateShaderProgram(meshVertexShaderSource, meshFragmentShaderSource, gMeshProgramId))
-        return EXIT_FAILURE;
-
-    if (!UCreateShaderProgram(lightVertexShaderSource, lightFragmentShaderSource, gLightProgramId))
-        return EXIT_FAILURE;
-
-    glUseProgram(gMeshProgramId);
-    glUniform1i(glGetUniformLocation(gMeshProgramId, "uTexture"), 0); // Set texture unit
-
-    // Sets the background color of the window to black (it will be implicitely used by glClear)
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-
-    // render loop
-    // -----------
-    while (!glfwWindowShouldClose(gWindow))
-    {
-        // per-frame timing
-        // --------------------
-        float currentFrame = glfwGetTime();
-        gDeltaTime = currentFrame - gLastFrame;
-        gLastFrame = currentFrame;
-
-        // input
-        // -----
-        UProcessInput(gWindow);
-
-        // Render this frame
-        URender();
-
-        glfwPollEvents();
-    }
-
-    UDestroyMesh();    // Release mesh data
-    UDestroyTexture(); // Release texture
-    UDestroyShaderProgram(); // Release shader programs
-
-    exit(EXIT_SUCCESS); // Terminates the program successfully
-}
-
-void UCreateCylinder(float x, float y, float z, float r, float h, const char* filename)
-{
-    struct Vert {
-        GLfloat x;
-        GLfloat y;
-        GLfloat z;
-        GLfloat nx;
-        GLfloat ny;
-        GLfloat nz;
-        GLfloat tx;
-        GLfloat ty;
-        Vert(GLfloat _x, GLfloat _y, GLfloat _z, GLfloat _nx, GLfloat _ny, GLfloat _nz, GLfloat _tx, GLfloat _ty)
-        {
-            x = _x;
-            y = _y;
-            z = _z;
-            nx = _nx;
-            ny = _ny;
-            nz = _nz;
-            tx = _tx;
-            ty = _ty;
-        }
-    };
-
-    vector<Vert> vertVector;
-    const float pi = 3.14159f;
-    const int nEdges = 12;
-    const int nVerts = nEdges * 6 * (3 + 3 + 2); // nEdges, Sides * 6 for the vertex per face, 3 normal map, 2 texture mapping
-    GLfloat verts[nVerts];
-    int currentEdge = 1;
-    for (int i = 0; i < nEdges * 6; i++)
-    {
-        switch (i % 6)
-        {
-        case 0:
-            vertVector.push_back(Vert(x + r * sin(2 * pi * currentEdge / nEdges), y + h / 2, z + r * cos(2 * pi * currentEdge / nEdges), 0.0f, 0.0f, 0.0f, 0.0f, 1.0f));
-            break;
-        case 1:
-            vertVector.push_back(Vert(x + r * sin(2 * pi * currentEdge / nEdges), y - h / 2, z + r * cos(2 * pi * currentEdge / nEdges), 0.0f, 0.0f, 0.0f, 0.0f, 0.0f));
-            break;
-        case 2:
-            addCounter(currentEdge, nEdges, 1);
-            vertVector.push_back(Vert(x + r * sin(2 * pi * currentEdge / nEdges), y + h / 2, z + r * cos(2 * pi * currentEdge / nEdges), 0.0f, 0.0f, 0.0f, 1.0f, 1.0f));
-            break;
-        case 3:
-            addCounter(currentEdge, nEdges, -1);
-            vertVector.push_back(Vert(x + r * sin(2 * pi * currentEdge / nEdges), y - h / 2, z + r * cos(2 * pi * currentEdge / nEdges), 0.0f, 0.0f, 0.0f, 0.0f, 0.0f));
-            break;
-        case 4:
-            addCounter(currentEdge, nEdges, 1);
-            vertVector.push_back(Vert(x + r * sin(2 * pi * currentEdge / nEdges), y + h / 2, z + r * cos(2 * pi * currentEdge / nEdges), 0.0f, 0.0f, 0.0f, 1.0f, 1.0f));
-            break;
-        case 5:
-            vertVector.push_back(Vert(x + r * sin(2 * pi * currentEdge / nEdges), y - h / 2, z + r * cos(2 * pi * currentEdge / nEdges), 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
-            break;
-        }
-    }
-
-    for (int i = 0; i < nVerts; i++)
-    {
-        Vert vert = vertVector[floor(i / 8)];
-        switch (i % 8)
-        {
-        case 0:
-            verts[i] = vert.x;
-            break;
-        case 1:
-            verts[i] = vert.y;
-            break;
-        case 2:
-            verts[i] = vert.z;
-            break;
-        case 3:
-            verts[i] = vert.nx;
-            break;
-        case 4:
-            verts[i] = vert.ny;
-            break;
-        case 5:
-            verts[i] = vert.nz;
-        case 6:
-            verts[i] = vert.tx;
-            break;
-        case 7:
-            verts[i] = vert.ty;
-            break;
-        }
-    }
-
-    GLMesh mesh;
-    if (!createTexture(filename, mesh.textureId))
-    {
-        cout << "Failed to load texture " << filename << endl;
-    }
-
-    const GLuint floatsPerVertex = 3;
-    const GLuint floatsPerNormal = 3;
-    const GLuint floatsPerUV = 2;
-
-    mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
-
-    glGenVertexArrays(1, &mesh.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.vao);
-
-    // Create 2 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(1, &mesh.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-    // Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);// The number of floats before each
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-    glEnableVertexAttribArray(2);
-
-    gMeshVector.push_back(mesh);
-}
-
-void UCreateCube(float x, float y, float z, float w, float h, float l, const char* filename)
-{
-    float s = 0.0f;
-    float f = 1.0f;
-    GLfloat verts[] = {
-        // pos             // normal
-        x + w, y + h, z + l, 0.0f, 0.0f, -1.0f, f, f,
-        x + w, y - h, z + l, 0.0f, 0.0f, -1.0f, f, s,
-        x - w, y + h, z + l, 0.0f, 0.0f, -1.0f, s, f,
-
-        x + w, y - h, z + l, 0.0f, 0.0f, -1.0f, f, s,
-        x - w, y - h, z + l, 0.0f, 0.0f, -1.0f, s, s,
-        x - w, y + h, z + l, 0.0f, 0.0f, -1.0f, s, f,
-
-        x + w, y + h, z + l, 1.0f, 0.0f, 0.0f, f, f,
-        x + w, y - h, z + l, 1.0f, 0.0f, 0.0f, s, f,
-        x + w, y - h, z - l, 1.0f, 0.0f, 0.0f, s, s,
-
-        x + w, y + h, z + l, 1.0f, 0.0f, 0.0f, f, f,
-        x + w, y - h, z - l, 1.0f, 0.0f, 0.0f, s, s,
-        x + w, y + h, z - l, 1.0f, 0.0f, 0.0f, f, s,
-
-        x + w, y + h, z + l, 0.0f, 1.0f, 0.0f, f, f,
-        x + w, y + h, z - l, 0.0f, 1.0f, 0.0f, f, s,
-        x - w, y + h, z - l, 0.0f, 1.0f, 0.0f, s, s,
-
-        x + w, y + h, z + l, 0.0f, 1.0f, 0.0f, f, f,
-        x - w, y + h, z + l, 0.0f, 1.0f, 0.0f, s, f,
-        x - w, y + h, z - l, 0.0f, 1.0f, 0.0f, s, s,
-
-        x + w, y - h, z - l, 0.0f, 0.0f,-1.0f, f, s,
-        x + w, y + h, z - l, 0.0f, 0.0f,-1.0f, f, f,
-        x - w, y + h, z - l, 0.0f, 0.0f,-1.0f, s, f,
-
-        x + w, y - h, z - l, 0.0f, 0.0f,-1.0f, f, s,
-        x - w, y + h, z - l, 0.0f, 0.0f,-1.0f, s, f,
-        x - w, y - h, z - l, 0.0f, 0.0f,-1.0f, s, s,
-
-        x - w, y - h, z + l,-1.0f, 0.0f, 0.0f, s, f,
-        x - w, y + h, z + l,-1.0f, 0.0f, 0.0f, f, f,
-        x - w, y + h, z - l,-1.0f, 0.0f, 0.0f, f, s,
-
-        x - w, y - h, z + l,-1.0f, 0.0f, 0.0f, s, f,
-        x - w, y + h, z - l,-1.0f, 0.0f, 0.0f, f, s,
-        x - w, y - h, z - l,-1.0f, 0.0f, 0.0f, s, s,
-
-        x + w, y - h, z + l, 0.0f,-1.0f, 0.0f, f, f,
-        x + w, y - h, z - l, 0.0f,-1.0f, 0.0f, f, s,
-        x - w, y - h, z - l, 0.0f,-1.0f, 0.0f, s, s,
-
-        x + w, y - h, z + l, 0.0f,-1.0f, 0.0f, f, f,
-        x - w, y - h, z + l, 0.0f,-1.0f, 0.0f, s, f,
-        x - w, y - h, z - l, 0.0f,-1.0f, 0.0f, s, s,
-    };
-
-    GLMesh mesh;
-    if (!createTexture(filename, mesh.textureId))
-    {
-        cout << "Failed to load texture " << filename << endl;
-    }
-
-    const GLuint floatsPerVertex = 3;
-    const GLuint floatsPerNormal = 3;
-    const GLuint floatsPerUV = 2;
-
-    mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
-
-    glGenVertexArrays(1, &mesh.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.vao);
-
-    // Create 2 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(1, &mesh.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-    // Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);// The number of floats before each
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-    glEnableVertexAttribArray(2);
-
-    gMeshVector.push_back(mesh);
-}
-
-/* 
-Creates a plane with the rule that point 1 and point 3 are on the opposite sides of the square.
-The edges go as 1-2-3 and 1-4-3.  It should look like:
-    1 ---- 2
-    |      |
-    |      |
-    4 ---- 3
-*/
-void UCreatePlane(
-    float x1, float y1, float z1, 
-    float x2, float y2, float z2,
-    float x3, float y3, float z3,
-    float x4, float y4, float z4, const char* filename)
-{
-    float s = 0.0f;
-    float f = 1.0f;
-    GLfloat verts[] = {
-        // pos          // normal
-        x1, y1, z1,  1.0f, 0.0f, 0.0f,  s, s,
-        x2, y2, z2,  1.0f, 0.0f, 0.0f,  s, f,
-        x3, y3, z3,  1.0f, 0.0f, 0.0f,  f, f,
-        x1, y1, z1,  1.0f, 0.0f, 0.0f,  s, s,
-        x4, y4, z4,  1.0f, 0.0f, 0.0f,  f, s,
-        x3, y3, z3,  1.0f, 0.0f, 0.0f,  f, f,
-    };
-
-    GLMesh mesh;
-    if (!createTexture(filename, mesh.textureId))
-    {
-        cout << "Failed to load texture " << filename << endl;
-    }
-
-    const GLuint floatsPerVertex = 3;
-    const GLuint floatsPerNormal = 3;
-    const GLuint floatsPerUV = 2;
-
-    mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
-
-    glGenVertexArrays(1, &mesh.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.vao);
-
-    // Create 2 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(1, &mesh.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-    // Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);// The number of floats before each
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-    glEnableVertexAttribArray(2);
-
-    gMeshVector.push_back(mesh);
-}
-
-// Creates a square pyramid
-void UCreatePyramid(float x, float y, float z, float w, float h, float l, const char* filename)
-{
-    GLfloat verts[] = {
-        // pos             // normal
-        x - w, y - h, z - l, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f,
-        x    , y + h, z    , 0.0f, 0.0f, -1.0f, 0.5f, 1.0f,
-        x + w, y - h, z - l, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f,
-
-        x - w, y - h, z + l, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-        x    , y + h, z    , 0.0f, 0.0f, 1.0f, 0.5f, 1.0f,
-        x + w, y - h, z + l, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f,
-
-        x - w, y - h, z - l, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-        x    , y + h, z    , -1.0f, 0.0f, 0.0f, 0.5f, 1.0f,
-        x - w, y - h, z + l, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-
-        x + w, y - h, z - l, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-        x    , y + h, z    , 1.0f, 0.0f, 0.0f, 0.5f, 1.0f,
-        x + w, y - h, z + l, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-
-        x - w, y - h, z - l, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-        x + w, y - h, z - l, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-        x - w, y - h, z + l, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-
-        x - w, y - h, z + l, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-        x + w, y - h, z + l, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f,
-        x + w, y - h, z - l, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-    };
-
-    GLMesh mesh;
-    if (!createTexture(filename, mesh.textureId))
-    {
-        cout << "Failed to load texture " << filename << endl;
-    }
-
-    const GLuint floatsPerVertex = 3;
-    const GLuint floatsPerNormal = 3;
-    const GLuint floatsPerUV = 2;
-
-    mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
-
-    glGenVertexArrays(1, &mesh.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.vao);
-
-    // Create 2 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(1, &mesh.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-    // Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);// The number of floats before each
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-    glEnableVertexAttribArray(2);
-
-    gMeshVector.push_back(mesh);
-}
-
-// Implements the UCreateShaders function
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint &programId)
-{
-    // Compilation and linkage error reporting
-    int success = 0;
-    char infoLog[512];
-
-    // Create a Shader program object.
-    programId = glCreateProgram();
-
-    // Create the vertex and fragment shader objects
-    GLuint vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
-
-    // Retrive the shader source
-    glShaderSource(vertexShaderId, 1, &vtxShaderSource, NULL);
-    glShaderSource(fragmentShaderId, 1, &fragShaderSource, NULL);
-
-    // Compile the vertex shader, and print compilation errors (if any)
-    glCompileShader(vertexShaderId); // compile the vertex shader
-    // check for shader compile errors
-    glGetShaderiv(vertexShaderId, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(vertexShaderId, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-
-        return false;
-    }
-
-    glCompileShader(fragmentShaderId); // compile the fragment shader
-    // check for shader compile errors
-    glGetShaderiv(fragmentShaderId, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(fragmentShaderId, sizeof(infoLog), NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-
-        return false;
-    }
-
-    // Attached compiled shaders to the shader program
-    glAttachShader(programId, vertexShaderId);
-    glAttachShader(programId, fragmentShaderId);
-
-    glLinkProgram(programId);   // links the shader program
-    // check for linking errors
-    glGetProgramiv(programId, GL_LINK_STATUS, &success);
-    if (!success)
-    {
-        glGetProgramInfoLog(programId, sizeof(infoLog), NULL, infoLog);
-        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-
-        return false;
-    }
-
-    glUseProgram(programId);    // Uses the shader program
-
-    return true;
-}
-
-
-// Destroys all the meshes
-void UDestroyMesh()
-{
-    for (GLMesh& mesh : gMeshVector)
-    {
-        glDeleteVertexArrays(1, &mesh.vao);
-        glDeleteBuffers(1, &mesh.vbo);
-    }
-}
-
-// Destroys all the shader programs
-void UDestroyShaderProgram()
-{
-    glDeleteProgram(gMeshProgramId);
-}
-
-// Destroys all the textures
-void UDestroyTexture()
-{
-    for (GLMesh mesh : gMeshVector)
-    {
-        glGenTextures(1, &mesh.textureId);
-    }
-}
-
-// Initialize GLFW, GLEW, and create a window
-bool UInitialize(int argc, char* argv[], GLFWwindow** window)
-{
-    // GLFW: initialize and configure
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
-    // GLFW: window creation
-    // ---------------------
-    * window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE, NULL, NULL);
-    if (*window == NULL)
-    {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return false;
-    }
-
-    glfwMakeContextCurrent(*window);
-    glfwSetFramebufferSizeCallback(*window, UResizeWindow);
-    glfwSetCursorPosCallback(*window, UMousePositionCallback);
-    glfwSetScrollCallback(*window, UMouseScrollCallback);
-
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(*window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-    // GLEW: initialize
-    // ----------------
-    // Note: if using GLEW version 1.13 or earlier
-    glewExperimental = GL_TRUE;
-    GLenum GlewInitResult = glewInit();
-
-    if (GLEW_OK != GlewInitResult)
-    {
-        std::cerr << glewGetErrorString(GlewInitResult) << std::endl;
-        return false;
-    }
-
-    // Displays GPU OpenGL version
-    cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << endl;
-
-    return true;
-}
-
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
-void UProcessInput(GLFWwindow* window)
-{
-    static const float cameraSpeed = 2.5f;
-
-    // Camera Movement
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(FORWARD, gDeltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(BACKWARD, gDeltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(LEFT, gDeltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(RIGHT, gDeltaTime);
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(DOWN, gDeltaTime);
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(UP, gDeltaTime);
-
-    // Perspective
-    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
-    {
-        if (!gIsPPressed)
-        {
-            gIsPPressed = true;
-            gCamera.IsPerspective ^= 1; // Flip the boolean with bitwise
-        }
-    }
-    else
-        gIsPPressed = false;
-
-    // Quit
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
-}
-
-// glfw: whenever the mouse moves, this callback is called
-void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos)
-{
-    if (gFirstMouse)
-    {
-        gLastX = xpos;
-        gLastY = ypos;
-        gFirstMouse = false;
-    }
-
-    float xoffset = xpos - gLastX;
-    float yoffset = gLastY - ypos; // reversed since y-coordinates go from bottom to top
-
-    gLastX = xpos;
-    gLastY = ypos;
-
-    gCamera.ProcessMouseMovement(xoffset, yoffset);
-}
-
-// glfw: whenever the mouse scroll wheel scrolls, this callback is called
-void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
-{
-    gCamera.ProcessMouseScroll(yoffset);
-}
-
-// Functioned called to render a frame
-void URender()
-{
-    // Enable z-depth
-    glEnable(GL_DEPTH_TEST);
-
-    // Clear the frame and z buffers
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    // Creates a projection based off perspective
-    glm::mat4 projection;
-    if (gCamera.IsPerspective)
-        projection = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
-    else
-        projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, -100.0f, 100.0f);
-
-    // Set the shader to be used
-    glUseProgram(gMeshProgramId);
-
-    // Retrieves and passes transform matrices to the Shader program
-    GLint modelLoc = glGetUniformLocation(gMeshProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gMeshProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gMeshProgramId, "projection");
-
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(glm::scale(glm::vec3(1.0f, 1.0f, 1.0f))));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(gCamera.GetViewMatrix()));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-    // Reference matrix uniforms from the Mesh Shader program for the mesh's color, light color, light position, and camera position
-    GLint objectColorLoc = glGetUniformLocation(gMeshProgramId, "objectColor");
-    GLint lightColorLoc = glGetUniformLocation(gMeshProgramId, "lightColor");
-    GLint lightPositionLoc = glGetUniformLocation(gMeshProgramId, "lightPos");
-    GLint viewPositionLoc = glGetUniformLocation(gMeshProgramId, "viewPosition");
-
-    // Pass color, light, and camera data to the Mesh Shader program's corresponding uniforms
-    glUniform3f(objectColorLoc, gObjectColor.r, gObjectColor.g, gObjectColor.b);
-    glUniform3f(lightColorLoc, gLightColor.r, gLightColor.g, gLightColor.b);
-    glUniform3f(lightPositionLoc, gLightPosition.x, gLightPosition.y, gLightPosition.z);
-    const glm::vec3 cameraPosition = gCamera.Position;
-    glUniform3f(viewPositionLoc, cameraPosition.x, cameraPosition.y, cameraPosition.z);
-
-    // Activate UV
-    GLint UVScaleLoc = glGetUniformLocation(gMeshProgramId, "uvScale");
-    glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gUVScale));
-
-    // Activate VBOs within each mesh
-    for (GLMesh &mesh : gMeshVector)
-    {
-        glBindVertexArray(mesh.vao);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, mesh.textureId);
-        glDrawArrays(GL_TRIANGLES, 0, mesh.nVertices);
-    }
-
-    // Deactivate the Vertex Array Object
-    glBindVertexArray(0);
-    glUseProgram(0);
-
-    // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-    glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
-}
-
-// glfw: whenever the window size changed (by OS or user resize) this callback function executes
-void UResizeWindow(GLFWwindow* window, int width, int height)
-{
-    glViewport(0, 0, width, height);
+#include <iostream>         // cout, cerr
+#include <cstdlib>          // EXIT_FAILURE
+#include <cstddef>          // offsetof
+#include <vector>           // Vector for list-like features
+#include <string>           // Texture cache keys
+#include <unordered_map>    // Texture cache
+#include <algorithm>        // sort
+#include <cmath>
+#include <thread>           // Batched primitive generation workers
+#include <fstream>          // Scene file, archive writer
+#include <cstdio>           // remove, rename
+#include <mutex>            // Mesh statistics from the generation workers
+#include <filesystem>       // Program cache directory
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+#include <glm/gtx/transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <GL/glew.h>        // GLEW library
+#include <GLFW/glfw3.h>     // GLFW library
+#include <camera.h>         // Camera Implementation
+#include <vertex_format.h>  // Full and packed vertex layouts
+#include <primitives.h>     // Procedural primitive generators
+#include <scene.h>          // Scene description parser
+#include <mapped_file.h>    // Memory mapped archive reads
+#include <archive.h>        // Baked scene archive layout
+#include <obj_import.h>     // Wavefront OBJ importer
+#include <gltf_import.h>    // Binary glTF importer
+#include <meshopt.h>        // Vertex cache, overdraw and fetch ordering
+#include <simplify.h>       // Quadric error LOD generation
+#include <culling.h>        // SIMD view frustum culling
+#include <bvh.h>            // Bounding volume hierarchy for culling and picking
+#include <occlusion.h>      // Software occlusion culling
+#include <render_queue.h>   // Draw sort keys and radix sort
+#include <transforms.h>     // Per-object model and normal matrices
+#include <program_cache.h>  // On-disk program binaries
+#include <shader_variants.h> // Mesh shader feature permutations
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>      // Image loading Utility functions
+
+using namespace std;        // Standard Namespace
+
+/*Shader program Macro*/
+#ifndef GLSL
+#define GLSL(Version, Source) "#version " #Version " core \n" #Source
+#endif
+
+/*Shared shader declarations Macro, inserted after the #version line by UCreateShaderProgram*/
+#define GLSL_PRELUDE(Source) #Source "\n"
+
+// WINDOW CONSTS
+const char* const WINDOW_TITLE = "Assignment 7-1";
+const int WINDOW_WIDTH = 800;
+const int WINDOW_HEIGHT = 600;
+const float ORTHO_HALF_EXTENT = 5.0f; // World units from the center of the orthographic view to each edge
+
+const GLuint MAX_MESH_LODS = 4;
+const size_t BVH_CULL_THRESHOLD = 256; // Below this many meshes the flat SIMD pass beats walking the tree
+const GLuint QUERY_MIN_TRIANGLES = 4096;  // Meshes this heavy at full detail are drawn behind an occlusion query
+const int QUERY_RING = 3;                 // Queries per heavy mesh, so new ones go out while older ones are in flight
+const uint64_t QUERY_MAX_AGE = 4;         // Frames a finished query still decides whether its mesh is drawn
+const GLuint GPU_CULL_GROUP_SIZE = 64;  // Draw slots per work group of the culling shader
+const GLuint GPU_CULL_FRAGMENT_UNIT = 64; // Window pixels per count of the culling shader's saved fragments total, keeping it far from wrapping
+const GLsizei HIZ_WIDTH = 256;          // Occluder depth target of the GPU culling, the window's aspect
+const GLsizei HIZ_HEIGHT = 192;
+const GLsizei HIZ_LEVELS = 7;           // Depth pyramid levels, halving down to 4x3
+const float LOD_TRIANGLE_RATIOS[MAX_MESH_LODS - 1] = { 0.5f, 0.25f, 0.125f }; // Triangles kept by each generated level, of the full mesh
+
+struct GLMeshLod // One level of detail of a mesh
+{
+    GLuint baseVertex;    // First vertex of the level inside the shared vertex buffer
+    GLuint firstIndex;    // First index of the level inside the shared index buffer
+    GLuint nIndices;      // Number of indices of the level
+    float error;          // Largest deviation from the full detail surface, in world units
+};
+
+struct GLMesh // Mesh Data
+{
+    GLMeshLod lods[MAX_MESH_LODS]; // Levels of detail, most detailed first
+    GLuint nLods;         // Number of levels in use
+    GLuint textureId;     // Image for mesh
+    glm::vec3 boundsMin;  // Axis aligned bounds of the most detailed level
+    glm::vec3 boundsMax;
+    glm::vec3 sphereCenter; // Bounding sphere of the most detailed level
+    float sphereRadius;
+    bool occluder = false;  // Fills its bounds, which are drawn into the occlusion buffer
+    glm::mat4 model = glm::mat4(1.0f); // Placement since upload, the bounds above include it
+    glm::vec3 restMin, restMax; // Bounds and sphere as uploaded, which model places anew each time it changes
+    glm::vec3 restSphereCenter;
+    float restSphereRadius;
+};
+
+/* Every static mesh is suballocated from one vertex and one index buffer under a single VAO.
+ * The generators only append to the staging vectors, UUploadGeometry sends them to the GPU once.
+ */
+struct GLGeometry
+{
+    GLuint vao;                     // Handle for the shared vertex array object
+    GLuint vbo;                     // Handle for the shared vertex buffer object
+    GLuint ebo;                     // Handle for the shared index buffer object
+    GLuint drawBuffer;              // Handle for the indirect draw command buffer
+    GLuint boundsBuffer;            // Per-mesh quantization bounds, only used by the packed layout
+    GLuint depthVao;                // Positions alone, for the depth pre-pass
+    GLuint positionBuffer;          // Tightly packed copy of every vertex position
+    GLuint objectBuffer;            // ObjectTransform of every mesh, read by the vertex shaders
+    GLuint objectIndexBuffer;       // 0 to n - 1, one per instance, so the base instance picks the mesh's transform
+    GLuint vertexStride;            // Bytes per vertex of the active layout
+    vector<unsigned char> vertices; // Staged vertex data, released after upload
+    vector<GLuint> indices;         // Staged index data, released after upload
+};
+
+struct DrawCommand // Matches the DrawElementsIndirectCommand layout read by glMultiDrawElementsIndirect
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLuint baseVertex;
+    GLuint baseInstance;
+};
+
+struct DrawBatch // Run of draw commands sharing a shader variant and a texture, submitted with one multi-draw
+{
+    unsigned int variant; // SHADER_ feature bits of its materials
+    GLuint textureId;
+    GLuint firstCommand;
+    GLuint nCommands;
+    GLuint nVisible;      // Commands that survived culling this frame, packed from firstCommand
+};
+
+// Batched primitive parameters, positions are centers and w, h, l are half extents
+struct BoxParams
+{
+    float x, y, z, w, h, l;
+    const char* filename;
+};
+
+struct PyramidParams
+{
+    float x, y, z, w, h, l;
+    const char* filename;
+};
+
+struct PlaneParams
+{
+    glm::vec3 corners[4]; // Corner 1 and 3 are opposite
+    const char* filename;
+};
+
+struct CylinderParams
+{
+    float x, y, z, r, h;
+    const char* filename;
+    GLuint nEdges;
+    bool capped;
+    GLuint nLods;
+};
+
+/* Occlusion queries of the heavy meshes. Each heavy mesh is drawn under conditional rendering on the newest query of
+ * its bounding box that has finished, so a hidden heavy mesh skips shading without the CPU ever waiting on the GPU.
+ */
+struct MeshQueries // Box queries of one heavy mesh
+{
+    GLuint queries[QUERY_RING];
+    uint64_t issued[QUERY_RING];  // Frame each was issued in
+    bool pending[QUERY_RING];     // Issued and not finished when last checked
+    int latest;                   // Newest finished query, -1 before the first one
+};
+
+struct GLQueryBoxes
+{
+    GLuint vao;                   // Unit cube, scaled onto each mesh's bounds
+    GLuint vbo;
+    GLuint ebo;
+    GLuint program;               // Depth tested, writes nothing
+    vector<MeshQueries> meshes;
+    vector<int> slotMeshes;       // Index into meshes of each draw slot, -1 for meshes drawn without queries
+};
+
+struct QueryDraw // Heavy mesh waiting to be drawn under its query
+{
+    GLuint slot;
+    DrawCommand command;
+};
+
+struct QueryStats
+{
+    size_t issued = 0;        // Box queries sent this frame
+    size_t resolved = 0;      // Draws made under a finished query
+    size_t hidden = 0;        // Of those, the ones whose box had no sample pass and skipped shading
+};
+
+struct PendingProgram // Program whose compile and link were started but not yet checked
+{
+    GLuint program;
+    GLuint shaders[2];
+    GLenum stages[2];
+    GLsizei nShaders;
+    uint64_t key;             // Its binary cache entry, written once it links
+};
+
+struct ProgramCacheStats
+{
+    size_t loaded = 0;        // Programs created from a cached binary
+    size_t compiled = 0;      // Programs compiled and linked from source
+    size_t rejected = 0;      // Cached binaries the driver refused, compiled instead
+    double seconds = 0.0;     // Spent creating programs either way
+};
+
+/* GPU driven culling (--gpu-culling). The occluders are drawn into a small depth target and reduced to a pyramid of
+ * farthest depths, then a compute shader tests every draw slot against the frustum and the pyramid, picks its level
+ * of detail and appends its command to its batch. The CPU cost per frame does not depend on the mesh count.
+ */
+struct GLGpuCulling
+{
+    GLuint cullProgram;       // Frustum and depth pyramid test, writes the draw commands
+    GLuint depthCopyProgram;  // Copies the occluder depth into the pyramid's first level
+    GLuint depthReduceProgram; // Builds each pyramid level from the one below
+    GLuint slotBuffer;        // GpuCullSlot of every draw slot
+    GLuint countBuffer;       // Commands written per batch, then the totals read by --stats
+    GLuint occluderBuffer;    // Indirect commands drawing the occluders
+    GLuint depthFramebuffer;
+    GLuint depthTexture;
+    GLuint hiZTexture;        // HIZ_LEVELS of farthest depth
+    GLsizei nOccluders;
+    GLuint nOccluderTriangles;
+    bool drawCount;           // ARB_indirect_parameters is there and each batch draws only what survived
+};
+
+struct GpuCullSlot // std430 layout of a draw slot in GLGpuCulling::slotBuffer
+{
+    glm::vec4 sphere;         // Center and radius
+    glm::vec4 boundsMin;
+    glm::vec4 boundsMax;
+    GLuint lods[MAX_MESH_LODS][4]; // nIndices, firstIndex, baseVertex and the error's float bits
+    GLuint nLods;
+    GLuint meshIndex;         // Base instance of the command
+    GLuint batch;
+    GLuint batchFirst;        // First command of the batch
+};
+
+const GLuint FRAME_UNIFORM_BINDING = 0; // Uniform buffer binding of the FrameData block
+const GLuint OBJECT_STORAGE_BINDING = 3; // Shader storage binding of the Objects buffer, after the culling shader's
+
+struct FrameUniforms // std140 layout of the FrameData block in frameDataShaderSource
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 lightColor;
+    float pad0;
+    glm::vec3 lightPos;
+    float pad1;
+    glm::vec3 viewPosition;
+    float pad2;
+    glm::vec3 objectColor;
+    float pad3;
+    glm::vec2 uvScale;
+    glm::vec2 pad4;
+};
+static_assert(sizeof(FrameUniforms) == 208, "FrameUniforms must match the std140 FrameData block");
+
+// Totals after the per batch counts in GLGpuCulling::countBuffer
+enum GpuCullTotal { GPU_CULL_VISIBLE, GPU_CULL_OCCLUDED, GPU_CULL_FRAGMENTS, GPU_CULL_TOTALS };
+
+const GLuint FRAME_RING_REGIONS = 3;            // Frames the CPU may run ahead of the GPU before it waits
+const GLsizeiptr FRAME_RING_SPARE = 64 * 1024;  // Room in each region beyond the frame uniforms and draw commands
+
+/* Persistently mapped buffer for the data rewritten every frame. It is split into FRAME_RING_REGIONS regions taken
+ * in turn, each guarded by a fence placed after the frame that used it, so the CPU writes straight into memory the
+ * GPU reads, without the driver copying or orphaning anything, and only waits once it is a whole ring ahead.
+ */
+struct GLFrameRing
+{
+    GLuint buffer;
+    unsigned char* mapped;              // The whole buffer, mapped coherent for its lifetime
+    GLsizeiptr regionSize;
+    GLsizeiptr uniformAlignment;        // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, regions start on it
+    GLuint region;                      // Region of the current frame
+    GLsizeiptr used;                    // Bump offset inside it
+    GLsync fences[FRAME_RING_REGIONS];  // After the frame that last used each region, 0 while none is pending
+    bool overflowed;                    // An allocation did not fit, reported once
+};
+
+const GLuint STATE_TEXTURE_UNITS = 4;   // Texture units the state cache tracks, higher ones always rebind
+const GLuint STATE_BUFFER_TARGETS = 5;  // Buffer targets it tracks, see UStateBufferTarget
+const GLuint STATE_BUFFER_INDICES = 4;  // Indexed bindings it tracks per target
+
+struct GLStateRange // An indexed buffer binding, size 0 for the whole buffer
+{
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+};
+
+struct GLStateCache // GL state as last set through the tracked setters, GL defaults until then
+{
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+    GLuint activeTexture = 0;                       // Unit, counted from GL_TEXTURE0
+    GLuint textures[STATE_TEXTURE_UNITS] = {};      // GL_TEXTURE_2D binding of each unit
+    GLuint buffers[STATE_BUFFER_TARGETS] = {};
+    GLStateRange ranges[STATE_BUFFER_TARGETS][STATE_BUFFER_INDICES] = {};
+    GLuint framebuffer = 0;
+    unordered_map<GLenum, bool> enables;            // Capabilities set so far
+    GLfloat clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    GLenum depthFunc = GL_LESS;
+    bool depthMask = true;
+    bool colorMask = true;
+    GLint viewport[4] = { 0, 0, 0, 0 };
+    size_t issued = 0;                              // Calls this frame that changed something
+    size_t skipped = 0;                             // Calls this frame skipped as redundant
+};
+
+struct DecodedImage // Image decoded off the GL thread, waiting for upload
+{
+    unsigned char* pixels;
+    int width, height, channels;
+};
+
+GLFWwindow* gWindow = nullptr; // Main GLFW window
+vector<GLMesh> gMeshVector; // Vector of all the meshes
+GLGeometry gGeometry; // Shared buffers of all the meshes
+bool gPackedVertices = false; // Use the 16 byte PackedVertex layout (--packed-vertices)
+bool gOptimizeMeshes = true; // Reorder each mesh for the vertex caches and overdraw (--no-mesh-optimize turns it off)
+bool gMeshStats = false; // Print the ACMR and ATVR of each mesh before and after optimizing (--mesh-stats)
+vector<DrawBatch> gDrawBatches; // Multi-draw batches, one per texture
+vector<GLuint> gDrawOrder; // Mesh indices sorted so each batch is contiguous
+GLuint gDrawCommandBuffer; // Buffer holding this frame's draw commands, the frame ring or the GPU culling's
+GLintptr gDrawCommandOffset = 0; // Offset of the first batch's commands inside it
+CullBounds gCullBounds; // Bounds of each draw command slot, in gDrawOrder order
+vector<uint8_t> gVisible; // Frustum test result of each slot for the current frame
+vector<GLuint> gMeshSlots; // Draw slot of each mesh, the inverse of gDrawOrder
+bool gObjectsDirty = false; // A mesh moved since the transforms were last uploaded
+Bvh gBvh; // Hierarchy over the draw slots, for culling large scenes and for ray and overlap queries
+CullStats gCullStats; // Visible and culled meshes of the last frame
+CullCache gCullCache; // Last full culling pass, reused while the camera barely moves
+OcclusionBuffer gOcclusion; // Depth of the occluders, tested against before each draw
+vector<GLuint> gOccluderSlots; // Draw slots of the meshes marked as occluders
+bool gOcclusionCulling = true; // Skip meshes hidden behind the occluders (--no-occlusion-culling turns it off)
+OcclusionStats gOcclusionStats; // Occluders drawn and draws saved in the last frame
+bool gGpuCulling = false; // Cull and pick levels of detail in a compute shader instead (--gpu-culling)
+GLGpuCulling gGpuCull; // Programs and buffers of the GPU culling
+bool gOcclusionQueries = true; // Draw heavy meshes behind occlusion queries (--no-occlusion-queries turns it off)
+GLQueryBoxes gQueryBoxes; // Bounding box queries of the heavy meshes
+vector<QueryDraw> gQueryDraws; // Heavy meshes that passed culling this frame
+QueryStats gQueryStats; // Occlusion queries of the last frame
+uint64_t gFrameIndex = 0; // Frames rendered so far
+RenderQueue gRenderQueue; // This frame's visible draws, sorted by state then front to back
+vector<DrawCommand> gSlotCommands; // Command picked for each visible slot, read back in sorted order
+bool gSortDraws = true; // Sort draws by key each frame (--no-draw-sort turns it off)
+bool gDepthPrepass = false; // Lay down depth first so each pixel is shaded once (--depth-prepass, Z toggles)
+bool gPrintStats = false; // Print the frame statistics once a second (--stats)
+float gLodErrorPixels = 1.0f; // Largest on-screen error, in pixels, a coarser LOD may introduce
+unordered_map<string, GLuint> gTextureCache; // Loaded textures by file name
+const char* gScenePath = "resources/scene.txt"; // Scene loaded at startup (--scene <path>)
+const char* gArchivePath = nullptr; // Baked archive loaded instead of the scene when given (--archive <path>)
+bool gDeferTextures = false; // While baking, textures get archive slots instead of being loaded
+vector<string> gDeferredTextures; // Name of each slot handed out while deferring
+unordered_map<GLuint, vector<unsigned char>> gDeferredImages; // Encoded bytes of deferred textures that came from memory
+unordered_map<GLuint, SceneLighting> gTextureLighting; // Lighting of the surfaces using each texture, Phong when absent
+
+// Texture
+glm::vec2 gUVScale(1.0f, 1.0f);
+GLint gTexWrapMode = GL_REPEAT;
+
+// Shader Programs
+GLuint gMeshProgramId; // Mesh Shader Id, the textured Phong variant most materials use
+GLuint gVariantPrograms[SHADER_VARIANTS] = {}; // Mesh program of each material variant, 0 until a batch needs it
+GLuint gLightProgramId; // Light Shader Id
+GLuint gDepthProgramId; // Depth pre-pass Shader Id
+unordered_map<GLuint, unordered_map<string, GLint>> gUniformLocations; // Every program's uniform locations, read once at link time
+const char* gProgramCacheDir = "shader_cache"; // Linked program binaries from earlier runs (--program-cache <dir>, --no-program-cache turns it off)
+ProgramCacheStats gProgramCacheStats; // Programs loaded and compiled at startup
+vector<PendingProgram> gPendingPrograms; // Programs submitted to the driver, checked by UFinishPrograms
+bool gParallelShaderCompile = false; // The driver compiles on its own threads and reports when a program is done
+GLFrameRing gFrameRing; // Per-frame uniforms and draw commands
+GLStateCache gState; // Bindings and render state, to skip calls that change nothing
+
+// Mesh Color
+glm::vec3 gObjectColor(1.f, 0.2f, 0.0f);
+glm::vec3 gLightColor(1.0f, 1.0f, 1.0f);
+
+// Light position and scale
+glm::vec3 gLightPosition(0.0f, 2.0f, 3.0f);
+
+// Camera
+glm::vec3 gCameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
+glm::vec3 gCameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
+glm::vec3 gCameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
+Camera gCamera(glm::vec3(0.0f, 0.0f, 3.0f));
+float gLastX = WINDOW_WIDTH / 2.0f;
+float gLastY = WINDOW_HEIGHT / 2.0f;
+bool gFirstMouse = true;
+
+bool gIsPPressed = false; // Prevents double-tapping P
+bool gIsPickPressed = false; // Picks once per left click
+int gPickedMesh = -1; // Last picked mesh, R spins it
+bool gIsZPressed = false; // Prevents double-tapping Z
+
+// Time
+float gDeltaTime = 0.0f; // time between current frame and last frame
+float gLastFrame = 0.0f;
+
+/* User-defined Function prototypes to:
+ * initialize the program, set the window size,
+ * redraw graphics on the window when resized,
+ * and render graphics on the screen
+ */
+bool createTexture(const char* filename, GLuint& textureId);
+bool UDecodeTexture(const char* filename, DecodedImage& image);
+bool UDecodeTextureFromMemory(const unsigned char* data, size_t size, DecodedImage& image);
+bool UUploadTexture(DecodedImage& image, GLuint& textureId);
+GLuint UGetTexture(const char* filename);
+GLuint UGetTextureFromMemory(const string& key, const unsigned char* data, size_t size);
+void UPreloadTextures(const vector<string>& filenames);
+bool UReadScene(const char* path, Scene& scene);
+void UCreateSceneMeshes(const Scene& scene);
+bool ULoadScene(const char* path);
+bool UBakeArchive(const char* scenePath, const char* archivePath);
+bool UValidateArchive(const MappedFile& archive);
+bool ULoadArchive(const char* path);
+void flipImageVertically(unsigned char* image, int width, int height, int channels);
+bool UInitialize(int, char* [], GLFWwindow** window);
+void UResizeWindow(GLFWwindow* window, int width, int height);
+void UProcessInput(GLFWwindow* window);
+void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos);
+void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
+void UCreateCube(float x, float y, float z, float w, float h, float l, const char* filename);
+void UCreateCylinder(float x, float y, float z, float r, float h, const char* filename, GLuint nEdges = 32, bool capped = true, GLuint nLods = 3);
+void UCreatePlane(
+    float x1, float y1, float z1, 
+    float x2, float y2, float z2,
+    float x3, float y3, float z3,
+    float x4, float y4, float z4, const char* filename
+);
+void UCreatePyramid(float x, float y, float z, float w, float h, float l, const char* filename);
+vector<GLuint> UCreateCubes(const BoxParams* boxes, size_t count);
+vector<GLuint> UCreatePyramids(const PyramidParams* pyramids, size_t count);
+vector<GLuint> UCreatePlanes(const PlaneParams* planes, size_t count);
+vector<GLuint> UCreateCylinders(const CylinderParams* cylinders, size_t count);
+GLuint UAddMesh(const GLfloat* verts, GLuint nVertices, const GLuint* indices, GLuint nIndices, const char* filename, float lodError = 0.0f);
+GLuint UAddTexturedMesh(const GLfloat* verts, GLuint nVertices, const GLuint* indices, GLuint nIndices, GLuint textureId, float lodError = 0.0f, GLuint nLods = 1);
+bool UImportModel(const char* path, const glm::mat4& transform, GLuint nLods = 1);
+void UAddMeshLod(GLuint meshIndex, const GLfloat* verts, GLuint nVertices, const GLuint* indices, GLuint nIndices, float lodError);
+void UGenerateLods(GLuint meshIndex, const GLfloat* verts, GLuint nVertices, const GLuint* indices, GLuint nIndices, GLuint nLods);
+void UComputeBounds(const GLfloat* verts, GLuint nVertices, GLMesh& mesh);
+void UPrintCacheStats(const string& label, const VertexCacheStats& before, const VertexCacheStats& after);
+GLuint USelectLod(const GLMesh& mesh, const glm::vec3& cameraPosition, float pixelsPerUnit, bool perspective);
+int UPickMesh(const glm::vec3& origin, const glm::vec3& direction, float& distance);
+void UUploadGeometry();
+void UUploadGeometry(const void* vertices, size_t vertexBytes, const GLuint* indices, size_t nIndices);
+void UDestroyMesh();
+void UDestroyTexture();
+void URender();
+void UCullOnCpu(const glm::mat4& view, const glm::mat4& projection, const glm::vec4 frustumPlanes[6], float pixelsPerUnit);
+void UDrawBatches(bool bindTextures);
+void UUploadObjects();
+void USetMeshTransform(GLuint meshIndex, const glm::mat4& model);
+bool UCreateGpuCulling();
+void UCullOnGpu(const glm::mat4& view, const glm::mat4& projection, const glm::vec4 frustumPlanes[6], float pixelsPerUnit);
+void UReadGpuCullStats();
+void UDestroyGpuCulling();
+bool UCreateQueryBoxes();
+void UDrawQueriedMeshes();
+void UDestroyQueryBoxes();
+bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
+bool UCreateComputeProgram(const char* computeShaderSource, GLuint& programId);
+bool UBeginProgram(const char* const* sources, const GLenum* stages, GLsizei nShaders, GLuint& programId);
+bool UFinishPrograms();
+unsigned int UMaterialVariant(bool textured, SceneLighting lighting);
+unsigned int UMeshVariant(GLuint textureId);
+bool USubmitVariantProgram(unsigned int variant);
+GLuint UVariantProgram(unsigned int variant);
+bool UFinishProgram(const PendingProgram& pending);
+void UReflectUniforms(GLuint programId);
+uint64_t UProgramKey(const char* const* sources, int nSources);
+bool ULoadProgramBinary(uint64_t key, GLuint& programId);
+void USaveProgramBinary(uint64_t key, GLuint programId);
+GLint UUniformLocation(GLuint programId, const char* name);
+bool UCreateFrameRing(GLsizeiptr regionSize);
+void UBeginFrameRing();
+void* UFrameRingAllocate(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset);
+void UEndFrameRing();
+void UDestroyFrameRing();
+int UStateBufferTarget(GLenum target);
+bool UStateChanged(bool changed);
+void UUseProgram(GLuint program);
+void UBindVertexArray(GLuint vertexArray);
+void UBindTexture(GLuint unit, GLuint texture);
+void UBindBuffer(GLenum target, GLuint buffer);
+void UBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+void UBindBufferBase(GLenum target, GLuint index, GLuint buffer);
+void UBindFramebuffer(GLuint framebuffer);
+void UEnable(GLenum capability, bool enabled);
+void UClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+void UDepthFunc(GLenum function);
+void UDepthMask(bool write);
+void UColorMask(bool write);
+void UViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+void UDestroyShaderProgram();
+
+/* Per-frame constants, given to every vertex and fragment stage. Its layout is FrameUniforms.*/
+const GLchar* frameDataShaderSource = GLSL_PRELUDE(
+	layout(std140, binding = 0) uniform FrameData
+	{
+	    mat4 view;
+	    mat4 projection;
+	    vec3 lightColor;
+	    vec3 lightPos;
+	    vec3 viewPosition;
+	    vec3 objectColor;
+	    vec2 uvScale;
+	};
+);
+
+/* Per mesh transforms, given to every vertex stage. ObjectData is laid out as ObjectTransform.*/
+const GLchar* objectDataShaderSource = GLSL_PRELUDE(
+	layout(location = 5) in uint objectIndex; // Per mesh, fetched through the draw's base instance
+	struct ObjectData
+	{
+	    mat4 model;
+	    vec4 normalMatrix[3]; // Inverse transpose of the model's 3x3, worked out on the CPU
+	};
+	layout(std430, binding = 3) readonly buffer Objects { ObjectData objects[]; };
+);
+
+/* Cube Vertex Shader Source Code*/
+const GLchar* meshVertexShaderSource = GLSL(440,
+	layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
+	layout(location = 1) in vec3 normal; // VAP position 1 for normals
+	layout(location = 2) in vec2 textureCoordinate;
+
+	out vec3 vertexNormal; // For outgoing normals to fragment shader
+	out vec3 vertexFragmentPos; // For outgoing color / pixels to fragment shader
+	out vec2 vertexTextureCoordinate;
+	invariant gl_Position; // Matches the depth pre-pass bit for bit
+
+	void main()
+	{
+	    ObjectData object = objects[objectIndex];
+	    gl_Position = projection * view * object.model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
+
+	    vertexFragmentPos = vec3(object.model * vec4(position, 1.0f)); // Gets fragment / pixel position in world space only (exclude view and projection)
+
+	    vertexNormal = mat3(object.normalMatrix[0].xyz, object.normalMatrix[1].xyz, object.normalMatrix[2].xyz) * normal; // get normal vectors in world space only and exclude normal translation properties
+	    vertexTextureCoordinate = textureCoordinate;
+	}
+);
+
+/* Packed Vertex Shader Source Code, decodes the PackedVertex layout*/
+const GLchar* meshPackedVertexShaderSource = GLSL(440,
+	layout(location = 0) in vec3 position; // Normalized 16 bit position inside the mesh bounds
+	layout(location = 1) in vec3 normal; // Normalized 10-10-10-2 normal
+	layout(location = 2) in vec2 textureCoordinate; // Half float UV
+	layout(location = 3) in vec3 boundsMin; // Per mesh, fetched through the draw's base instance
+	layout(location = 4) in vec3 boundsExtent;
+
+	out vec3 vertexNormal; // For outgoing normals to fragment shader
+	out vec3 vertexFragmentPos; // For outgoing color / pixels to fragment shader
+	out vec2 vertexTextureCoordinate;
+	invariant gl_Position; // Matches the depth pre-pass bit for bit
+
+	void main()
+	{
+	    vec3 meshPosition = boundsMin + position * boundsExtent; // Undo the quantization
+
+	    ObjectData object = objects[objectIndex];
+	    gl_Position = projection * view * object.model * vec4(meshPosition, 1.0f); // Transforms vertices into clip coordinates
+
+	    vertexFragmentPos = vec3(object.model * vec4(meshPosition, 1.0f)); // Gets fragment / pixel position in world space only (exclude view and projection)
+
+	    vertexNormal = mat3(object.normalMatrix[0].xyz, object.normalMatrix[1].xyz, object.normalMatrix[2].xyz) * normal; // get normal vectors in world space only and exclude normal translation properties
+	    vertexTextureCoordinate = textureCoordinate;
+	}
+);
+
+/* Cube Fragment Shader Source Code. Compiled once per material variant, the FEATURE_ defines come from
+ * InjectShaderDefines and the branches on them fold away.*/
+const GLchar* meshFragmentShaderSource = GLSL(440,
+    in vec3 vertexNormal; // For incoming normals
+	in vec3 vertexFragmentPos; // For incoming fragment position
+	in vec2 vertexTextureCoordinate;
+	out vec4 fragmentColor; // For outgoing cube color to the GPU
+
+	uniform sampler2D uTexture; // Useful when working with multiple textures
+
+	void main()
+	{
+	    // Texture holds the color to be used for all three components, untextured meshes use the object color
+	    vec3 baseColor = objectColor;
+	    if (FEATURE_TEXTURE != 0)
+	        baseColor = texture(uTexture, vertexTextureCoordinate * uvScale).xyz;
+
+	    // Unlit materials show their color as is
+	    if (FEATURE_LIGHTING == 0)
+	    {
+	        fragmentColor = vec4(baseColor, 1.0);
+	        return;
+	    }
+
+	    /*Phong lighting model calculations to generate ambient, diffuse, and specular components*/
+
+	    //Calculate Ambient lighting*/
+	    float ambientStrength = .4f; // Set ambient or global lighting strength
+	    vec3 ambient = ambientStrength * lightColor; // Generate ambient light color
+
+	    //Calculate Diffuse lighting*/
+	    vec3 norm = normalize(vertexNormal); // Normalize vectors to 1 unit
+	    vec3 lightDirection = normalize(lightPos - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+	    float impact = max(dot(norm, lightDirection), 0.0);// Calculate diffuse impact by generating dot product of normal and light
+	    vec3 diffuse = impact * lightColor; // Generate diffuse light color
+	    vec3 lighting = ambient + diffuse;
+
+	    // Matte materials skip the highlight
+	    if (FEATURE_SPECULAR != 0)
+	    {
+	        //Calculate Specular lighting*/
+	        float specularIntensity = 0.8f; // Set specular light strength
+	        float highlightSize = 16.0f; // Set specular highlight size
+	        vec3 viewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
+	        vec3 reflectDir = reflect(-lightDirection, norm);// Calculate reflection vector
+	        //Calculate specular component
+	        float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), highlightSize);
+	        vec3 specular = specularIntensity * specularComponent * lightColor;
+	        lighting = lighting + specular;
+	    }
+
+	    // Calculate phong result
+	    vec3 phong = lighting * baseColor;
+
+	    fragmentColor = vec4(phong, 1.0); // Send lighting results to GPU
+	}
+);
+
+/* Depth pre-pass Vertex Shader Source Code, the mesh shader's position math alone*/
+const GLchar* depthVertexShaderSource = GLSL(440,
+	layout(location = 0) in vec3 position;
+	invariant gl_Position;
+
+	void main()
+	{
+	    gl_Position = projection * view * objects[objectIndex].model * vec4(position, 1.0f);
+	}
+);
+
+/* Depth pre-pass Vertex Shader Source Code for the PackedVertex layout*/
+const GLchar* depthPackedVertexShaderSource = GLSL(440,
+	layout(location = 0) in vec3 position;
+	layout(location = 3) in vec3 boundsMin;
+	layout(location = 4) in vec3 boundsExtent;
+	invariant gl_Position;
+
+	void main()
+	{
+	    vec3 meshPosition = boundsMin + position * boundsExtent;
+	    gl_Position = projection * view * objects[objectIndex].model * vec4(meshPosition, 1.0f);
+	}
+);
+
+/* Depth pre-pass Fragment Shader Source Code, writes depth only*/
+const GLchar* depthFragmentShaderSource = GLSL(440,
+	void main()
+	{
+	}
+);
+
+/* Lamp Shader Source Code*/
+const GLchar* lightVertexShaderSource = GLSL(440,
+    layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
+
+    //Uniform / Global variables for the  transform matrices
+	uniform mat4 model;
+
+	void main()
+	{
+	    gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
+	}
+);
+
+/* Fragment Shader Source Code*/
+const GLchar* lightFragmentShaderSource = GLSL(440,
+    out vec4 fragmentColor; // For outgoing lamp color (smaller cube) to the GPU
+
+	void main()
+	{
+	    fragmentColor = vec4(1.0f); // Set color to white (1.0f,1.0f,1.0f) with alpha 1.0
+	}
+);
+
+/* Query box Vertex Shader Source Code, places the unit cube on a mesh's bounds*/
+const GLchar* queryBoxVertexShaderSource = GLSL(440,
+	layout(location = 0) in vec3 position; // Unit cube corner
+
+	uniform vec3 boxMin;
+	uniform vec3 boxSize;
+
+	void main()
+	{
+	    gl_Position = projection * view * vec4(boxMin + position * boxSize, 1.0f);
+	}
+);
+
+/* Query box Fragment Shader Source Code, color writes are masked off while it runs*/
+const GLchar* queryBoxFragmentShaderSource = GLSL(440,
+	out vec4 fragmentColor;
+
+	void main()
+	{
+	    fragmentColor = vec4(1.0f);
+	}
+);
+
+/* GPU culling Compute Shader Source Code, one draw slot per invocation*/
+const GLchar* cullComputeShaderSource = GLSL(440,
+	layout(local_size_x = 64) in; // GPU_CULL_GROUP_SIZE
+
+	struct Slot
+	{
+	    vec4 sphere;
+	    vec4 boundsMin;
+	    vec4 boundsMax;
+	    uvec4 lods[4]; // MAX_MESH_LODS of nIndices, firstIndex, baseVertex, error bits
+	    uint nLods;
+	    uint meshIndex;
+	    uint batch;
+	    uint batchFirst;
+	};
+
+	struct Command
+	{
+	    uint count;
+	    uint instanceCount;
+	    uint firstIndex;
+	    uint baseVertex;
+	    uint baseInstance;
+	};
+
+	layout(std430, binding = 0) readonly buffer Slots { Slot slots[]; };
+	layout(std430, binding = 1) writeonly buffer Commands { Command commands[]; };
+	layout(std430, binding = 2) buffer Counts { uint counts[]; }; // Per batch, then visible, occluded and fragments in GPU_CULL_FRAGMENT_UNIT
+
+	uniform uint nSlots;
+	uniform uint nBatches;
+	uniform vec4 planes[6];
+	uniform mat4 viewProjection;
+	uniform vec3 cameraPosition;
+	uniform bool perspective;
+	uniform float pixelsPerUnit;
+	uniform float lodErrorPixels;
+	uniform bool occlusion; // The depth pyramid holds occluders
+	uniform bool compact;   // Survivors are packed to the front of their batch, otherwise culled commands draw no instances
+	uniform vec2 windowSize;
+	uniform sampler2D hiZ;
+
+	// Whether the occluders hide the whole box. windowArea receives its screen rectangle in window pixels.
+	bool Occluded(vec3 boxMin, vec3 boxMax, out float windowArea)
+	{
+	    vec2 rectMin = vec2(1.0);
+	    vec2 rectMax = vec2(0.0);
+	    float nearest = 1.0;
+	    windowArea = 0.0;
+	    for (int c = 0; c < 8; c++)
+	    {
+	        vec3 corner = mix(boxMin, boxMax, vec3(c & 1, (c >> 1) & 1, (c >> 2) & 1));
+	        vec4 clip = viewProjection * vec4(corner, 1.0);
+	        if (clip.w <= 0.0 || clip.z < -clip.w)
+	            return false; // Reaches behind the near plane
+	        vec3 window = clip.xyz / clip.w * 0.5 + 0.5;
+	        rectMin = min(rectMin, window.xy);
+	        rectMax = max(rectMax, window.xy);
+	        nearest = min(nearest, window.z);
+	    }
+
+	    // Texels under the rectangle, grown by one so partly covered edge texels never decide
+	    ivec2 size = textureSize(hiZ, 0);
+	    ivec2 texelMin = max(ivec2(floor(rectMin * vec2(size))) - 1, ivec2(0));
+	    ivec2 texelMax = min(ivec2(floor(rectMax * vec2(size))) + 1, size - 1);
+	    if (any(greaterThan(texelMin, texelMax)))
+	        return false;
+	    vec2 clamped = clamp(rectMax, 0.0, 1.0) - clamp(rectMin, 0.0, 1.0);
+	    windowArea = clamped.x * clamped.y * windowSize.x * windowSize.y;
+
+	    // The level where the rectangle spans at most two texels each way, short of the top one
+	    ivec2 span = texelMax - texelMin + 1;
+	    int level = min(int(ceil(log2(float(max(span.x, span.y))))), 6); // HIZ_LEVELS - 1
+	    ivec2 levelMin = texelMin >> level;
+	    ivec2 levelMax = texelMax >> level;
+	    for (int y = levelMin.y; y <= levelMax.y; y++)
+	    {
+	        for (int x = levelMin.x; x <= levelMax.x; x++)
+	        {
+	            if (texelFetch(hiZ, ivec2(x, y), level).r >= nearest)
+	                return false;
+	        }
+	    }
+	    return true;
+	}
+
+	void main()
+	{
+	    uint i = gl_GlobalInvocationID.x;
+	    if (i >= nSlots)
+	        return;
+	    Slot slot = slots[i];
+
+	    // Both the sphere and the box have to reach inside every plane, as on the CPU
+	    vec3 center = (slot.boundsMin.xyz + slot.boundsMax.xyz) * 0.5;
+	    vec3 extent = (slot.boundsMax.xyz - slot.boundsMin.xyz) * 0.5;
+	    bool visible = true;
+	    for (int p = 0; p < 6; p++)
+	    {
+	        float sphereDistance = dot(planes[p].xyz, slot.sphere.xyz) + planes[p].w;
+	        float boxDistance = dot(planes[p].xyz, center) + planes[p].w + dot(abs(planes[p].xyz), extent);
+	        visible = visible && sphereDistance > -slot.sphere.w && boxDistance >= 0.0;
+	    }
+
+	    float windowArea;
+	    if (visible)
+	    {
+	        atomicAdd(counts[nBatches], 1u);
+	        if (occlusion && Occluded(slot.boundsMin.xyz, slot.boundsMax.xyz, windowArea))
+	        {
+	            atomicAdd(counts[nBatches + 1u], 1u);
+	            atomicAdd(counts[nBatches + 2u], uint(ceil(windowArea / 64.0))); // GPU_CULL_FRAGMENT_UNIT
+	            visible = false;
+	        }
+	    }
+
+	    if (!visible)
+	    {
+	        if (!compact)
+	            commands[i] = Command(0u, 0u, 0u, 0u, 0u);
+	        return;
+	    }
+
+	    // Coarsest level whose error stays under lodErrorPixels, as USelectLod picks it
+	    uint lod = 0u;
+	    float distance = 1.0;
+	    if (perspective)
+	        distance = length(cameraPosition - clamp(cameraPosition, slot.boundsMin.xyz, slot.boundsMax.xyz));
+	    if (distance > 0.0)
+	    {
+	        for (uint l = 1u; l < slot.nLods; l++)
+	        {
+	            if (uintBitsToFloat(slot.lods[l].w) * pixelsPerUnit / distance > lodErrorPixels)
+	                break;
+	            lod = l;
+	        }
+	    }
+
+	    uint command = compact ? slot.batchFirst + atomicAdd(counts[slot.batch], 1u) : i;
+	    commands[command] = Command(slot.lods[lod].x, 1u, slot.lods[lod].y, slot.lods[lod].z, slot.meshIndex);
+	}
+);
+
+/* Copies the occluder depth into the first level of the depth pyramid*/
+const GLchar* depthCopyComputeShaderSource = GLSL(440,
+	layout(local_size_x = 8, local_size_y = 8) in;
+
+	uniform sampler2D depth;
+	layout(r32f, binding = 0) writeonly uniform image2D destination;
+
+	void main()
+	{
+	    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	    if (any(greaterThanEqual(texel, imageSize(destination))))
+	        return;
+	    imageStore(destination, texel, vec4(texelFetch(depth, texel, 0).r));
+	}
+);
+
+/* Builds a depth pyramid level, each texel the farthest of the four below it*/
+const GLchar* depthReduceComputeShaderSource = GLSL(440,
+	layout(local_size_x = 8, local_size_y = 8) in;
+
+	layout(r32f, binding = 0) readonly uniform image2D source;
+	layout(r32f, binding = 1) writeonly uniform image2D destination;
+
+	void main()
+	{
+	    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	    if (any(greaterThanEqual(texel, imageSize(destination))))
+	        return;
+	    ivec2 below = texel * 2;
+	    float farthest = max(max(imageLoad(source, below).r, imageLoad(source, below + ivec2(1, 0)).r),
+	                         max(imageLoad(source, below + ivec2(0, 1)).r, imageLoad(source, below + ivec2(1, 1)).r));
+	    imageStore(destination, texel, vec4(farthest));
+	}
+);
+
+/*Generate and load the texture*/
+bool createTexture(const char* filename, GLuint& textureId)
+{
+    DecodedImage image;
+    if (!UDecodeTexture(filename, image))
+        return false;
+
+    return UUploadTexture(image, textureId);
+}
+
+/*Decodes and flips an image. Touches no GL state, so it is safe on any thread*/
+bool UDecodeTexture(const char* filename, DecodedImage& image)
+{
+    image.pixels = stbi_load(filename, &image.width, &image.height, &image.channels, 0);
+    if (!image.pixels)
+        return false;
+
+    flipImageVertically(image.pixels, image.width, image.height, image.channels);
+    return true;
+}
+
+/*Decodes and flips an image held in memory, such as one embedded in a model*/
+bool UDecodeTextureFromMemory(const unsigned char* data, size_t size, DecodedImage& image)
+{
+    image.pixels = stbi_load_from_memory(data, (int)size, &image.width, &image.height, &image.channels, 0);
+    if (!image.pixels)
+        return false;
+
+    flipImageVertically(image.pixels, image.width, image.height, image.channels);
+    return true;
+}
+
+/*Creates a texture from a decoded image and frees the pixels*/
+bool UUploadTexture(DecodedImage& image, GLuint& textureId)
+{
+    if (image.channels != 3 && image.channels != 4)
+    {
+        cout << "Not implemented to handle image with " << image.channels << " channels" << endl;
+        stbi_image_free(image.pixels);
+        image.pixels = nullptr;
+        return false;
+    }
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &textureId);
+
+    // set the texture wrapping parameters
+    glTextureParameteri(textureId, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(textureId, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    // set texture filtering parameters
+    glTextureParameteri(textureId, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(textureId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // Immutable storage for the whole mip chain, halving down to 1x1
+    GLsizei nLevels = 1;
+    while ((max(image.width, image.height) >> nLevels) > 0)
+        nLevels++;
+    glTextureStorage2D(textureId, nLevels, image.channels == 3 ? GL_RGB8 : GL_RGBA8, image.width, image.height);
+    glTextureSubImage2D(textureId, 0, 0, 0, image.width, image.height, image.channels == 3 ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+
+    glGenerateTextureMipmap(textureId);
+
+    stbi_image_free(image.pixels);
+    image.pixels = nullptr;
+
+    return true;
+}
+
+/*Returns the texture for the file, loading it only the first time it is requested*/
+GLuint UGetTexture(const char* filename)
+{
+    auto cached = gTextureCache.find(filename);
+    if (cached != gTextureCache.end())
+        return cached->second;
+
+    GLuint textureId = 0;
+    if (gDeferTextures)
+    {
+        gDeferredTextures.push_back(filename);
+        textureId = gDeferredTextures.size(); // Slot + 1, so that 0 still means no texture
+    }
+    else if (!createTexture(filename, textureId))
+    {
+        cout << "Failed to load texture " << filename << endl;
+    }
+
+    gTextureCache[filename] = textureId;
+    return textureId;
+}
+
+/*Returns the texture for an encoded image in memory, cached under key*/
+GLuint UGetTextureFromMemory(const string& key, const unsigned char* data, size_t size)
+{
+    auto cached = gTextureCache.find(key);
+    if (cached != gTextureCache.end())
+        return cached->second;
+
+    GLuint textureId = 0;
+    DecodedImage image;
+    if (gDeferTextures)
+    {
+        gDeferredTextures.push_back(key);
+        textureId = gDeferredTextures.size(); // Slot + 1, so that 0 still means no texture
+        gDeferredImages[textureId].assign(data, data + size);
+    }
+    else if (!data || !UDecodeTextureFromMemory(data, size, image) || !UUploadTexture(image, textureId))
+    {
+        cout << "Failed to load texture " << key << endl;
+    }
+
+    gTextureCache[key] = textureId;
+    return textureId;
+}
+
+/* Loads every texture not yet in the cache.
+ * Decoding dominates load time, so the files are decoded on worker threads and only the uploads stay on this one.
+ */
+void UPreloadTextures(const vector<string>& filenames)
+{
+    if (gDeferTextures)
+        return;
+
+    vector<string> pending;
+    for (const string& filename : filenames)
+    {
+        if (gTextureCache.find(filename) == gTextureCache.end()
+            && std::find(pending.begin(), pending.end(), filename) == pending.end())
+            pending.push_back(filename);
+    }
+
+    vector<DecodedImage> images(pending.size());
+    vector<char> decoded(pending.size(), 0);
+    size_t nThreads = std::max<size_t>(1, std::min<size_t>(thread::hardware_concurrency(), pending.size()));
+    vector<thread> workers;
+    for (size_t t = 0; t < nThreads; t++)
+    {
+        workers.emplace_back([&, t]()
+        {
+            for (size_t i = t; i < pending.size(); i += nThreads)
+                decoded[i] = UDecodeTexture(pending[i].c_str(), images[i]);
+        });
+    }
+    for (thread& worker : workers)
+        worker.join();
+
+    for (size_t i = 0; i < pending.size(); i++)
+    {
+        GLuint textureId = 0;
+        if (!decoded[i] || !UUploadTexture(images[i], textureId))
+            cout << "Failed to load texture " << pending[i] << endl;
+
+        gTextureCache[pending[i]] = textureId;
+    }
+}
+
+// Images are loaded with Y axis going down, but OpenGL's Y axis goes up, so let's flip it
+void flipImageVertically(unsigned char* image, int width, int height, int channels)
+{
+    for (int j = 0; j < height / 2; ++j)
+    {
+        int index1 = j * width * channels;
+        int index2 = (height - 1 - j) * width * channels;
+
+        for (int i = width * channels; i > 0; --i)
+        {
+            unsigned char tmp = image[index1];
+            image[index1] = image[index2];
+            image[index2] = tmp;
+            ++index1;
+            ++index2;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char* bakePath = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (string(argv[i]) == "--packed-vertices")
+            gPackedVertices = true;
+        else if (string(argv[i]) == "--no-mesh-optimize")
+            gOptimizeMeshes = false;
+        else if (string(argv[i]) == "--mesh-stats")
+            gMeshStats = true;
+        else if (string(argv[i]) == "--stats")
+            gPrintStats = true;
+        else if (string(argv[i]) == "--no-occlusion-culling")
+            gOcclusionCulling = false;
+        else if (string(argv[i]) == "--gpu-culling")
+            gGpuCulling = true;
+        else if (string(argv[i]) == "--no-occlusion-queries")
+            gOcclusionQueries = false;
+        else if (string(argv[i]) == "--no-draw-sort")
+            gSortDraws = false;
+        else if (string(argv[i]) == "--depth-prepass")
+            gDepthPrepass = true;
+        else if (string(argv[i]) == "--scene" && i + 1 < argc)
+            gScenePath = argv[++i];
+        else if (string(argv[i]) == "--archive" && i + 1 < argc)
+            gArchivePath = argv[++i];
+        else if (string(argv[i]) == "--bake" && i + 1 < argc)
+            bakePath = argv[++i];
+        else if (string(argv[i]) == "--program-cache" && i + 1 < argc)
+            gProgramCacheDir = argv[++i];
+        else if (string(argv[i]) == "--no-program-cache")
+            gProgramCacheDir = nullptr;
+    }
+
+    // Baking needs no window, write the archive and quit
+    if (bakePath)
+        return UBakeArchive(gScenePath, bakePath) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    if (!UInitialize(argc, argv, &gWindow))
+        return EXIT_FAILURE;
+
+    // Program binaries need a driver that can hand them out
+    GLint nBinaryFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nBinaryFormats);
+    if (nBinaryFormats == 0)
+        gProgramCacheDir = nullptr;
+
+    // The GPU culling writes every command itself, so heavy meshes only get queries on the CPU path
+    if (gGpuCulling)
+        gOcclusionQueries = false;
+
+	// Create the shader programs. They are only submitted here and compile while the scene loads below.
+    unsigned int meshVariant = UMaterialVariant(true, SCENE_LIGHTING_PHONG);
+    if (!USubmitVariantProgram(meshVariant))
+        return EXIT_FAILURE;
+    gMeshProgramId = gVariantPrograms[meshVariant];
+
+    if (!UCreateShaderProgram(lightVertexShaderSource, lightFragmentShaderSource, gLightProgramId))
+        return EXIT_FAILURE;
+
+    if (!UCreateShaderProgram(gPackedVertices ? depthPackedVertexShaderSource : depthVertexShaderSource, depthFragmentShaderSource, gDepthProgramId))
+        return EXIT_FAILURE;
+
+    if (gGpuCulling && (!UCreateComputeProgram(cullComputeShaderSource, gGpuCull.cullProgram)
+        || !UCreateComputeProgram(depthCopyComputeShaderSource, gGpuCull.depthCopyProgram)
+        || !UCreateComputeProgram(depthReduceComputeShaderSource, gGpuCull.depthReduceProgram)))
+        return EXIT_FAILURE;
+
+    if (gOcclusionQueries && !UCreateShaderProgram(queryBoxVertexShaderSource, queryBoxFragmentShaderSource, gQueryBoxes.program))
+        return EXIT_FAILURE;
+
+    // Create the meshs, from the baked archive when there is a usable one
+    if (!gArchivePath || !ULoadArchive(gArchivePath))
+    {
+        if (!ULoadScene(gScenePath))
+            return EXIT_FAILURE;
+
+        // Send every mesh to the GPU in one upload
+        UUploadGeometry();
+    }
+
+    // The other variants the materials need, known now that the batches are
+    for (const DrawBatch& batch : gDrawBatches)
+    {
+        if (!USubmitVariantProgram(batch.variant))
+            return EXIT_FAILURE;
+    }
+
+    if (!UFinishPrograms())
+        return EXIT_FAILURE;
+
+    if (gGpuCulling && !UCreateGpuCulling())
+        return EXIT_FAILURE;
+
+    if (gOcclusionQueries && !UCreateQueryBoxes())
+        return EXIT_FAILURE;
+
+    // The occlusion workers only run when the CPU culling pass has occluders to draw
+    if (gOcclusionCulling && !gGpuCulling && !gOccluderSlots.empty())
+        gOcclusion.start();
+
+    for (GLuint program : gVariantPrograms)
+    {
+        if (program)
+            glProgramUniform1i(program, UUniformLocation(program, "uTexture"), 0); // Set texture unit
+    }
+
+    // Meshes read their transforms from the Objects buffer, only the lamp keeps a model uniform
+    glProgramUniformMatrix4fv(gLightProgramId, UUniformLocation(gLightProgramId, "model"), 1, GL_FALSE, glm::value_ptr(glm::scale(glm::vec3(1.0f, 1.0f, 1.0f))));
+
+    // Each frame writes its uniforms and, culling on the CPU, one command per draw slot
+    if (!UCreateFrameRing(sizeof(FrameUniforms) + gDrawOrder.size() * sizeof(DrawCommand) + FRAME_RING_SPARE))
+        return EXIT_FAILURE;
+
+    if (gPrintStats)
+        cout << "Shader programs " << gProgramCacheStats.loaded << " from cache, " << gProgramCacheStats.compiled << " compiled ("
+             << gProgramCacheStats.rejected << " stale), " << gProgramCacheStats.seconds * 1000.0 << " ms waiting on them, startup "
+             << glfwGetTime() * 1000.0 << " ms" << endl;
+
+    // Sets the background color of the window to black (it will be implicitely used by glClear)
+    UClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    // render loop
+    // -----------
+    while (!glfwWindowShouldClose(gWindow))
+    {
+        // per-frame timing
+        // --------------------
+        float currentFrame = glfwGetTime();
+        gDeltaTime = currentFrame - gLastFrame;
+        gLastFrame = currentFrame;
+
+        // input
+        // -----
+        UProcessInput(gWindow);
+
+        // Render this frame
+        URender();
+
+        if (gPrintStats && (int)currentFrame != (int)(currentFrame - gDeltaTime))
+        {
+            if (gGpuCulling)
+                UReadGpuCullStats();
+            cout << "Meshes visible " << gCullStats.visible << ", culled " << gCullStats.culled << ", tested " << gCullStats.tested << endl;
+            if (!gOccluderSlots.empty() && gOcclusionCulling)
+                cout << "Occluders " << gOcclusionStats.occluders << " (" << gOcclusionStats.triangles << " triangles), occluded "
+                     << gOcclusionStats.occluded << " of " << gOcclusionStats.tested << " draws, up to "
+                     << (size_t)gOcclusionStats.fragments << " fragments saved" << endl;
+            if (!gQueryBoxes.meshes.empty())
+                cout << "Occlusion queries " << gQueryStats.issued << ", hidden " << gQueryStats.hidden << " of " << gQueryStats.resolved
+                     << " resolved (" << (gQueryStats.resolved ? 100 * gQueryStats.hidden / gQueryStats.resolved : 0) << "% hit rate)" << endl;
+            cout << "GL state calls " << gState.issued << ", redundant skipped " << gState.skipped << endl;
+        }
+
+        glfwPollEvents();
+    }
+
+    if (gGpuCulling)
+        UDestroyGpuCulling();
+    if (gOcclusionQueries)
+        UDestroyQueryBoxes();
+    UDestroyMesh();    // Release mesh data
+    UDestroyTexture(); // Release texture
+    UDestroyShaderProgram(); // Release shader programs
+
+    exit(EXIT_SUCCESS); // Terminates the program successfully
+}
+
+/*
+Creates a cylinder with nEdges sides and a chain of nLods levels of detail.
+Each level halves the edge count of the previous one, down to a triangular prism.
+*/
+void UCreateCylinder(float x, float y, float z, float r, float h, const char* filename, GLuint nEdges, bool capped, GLuint nLods)
+{
+    CylinderParams cylinder = { x, y, z, r, h, filename, nEdges, capped, nLods };
+    UCreateCylinders(&cylinder, 1);
+}
+
+void UCreateCube(float x, float y, float z, float w, float h, float l, const char* filename)
+{
+    BoxParams box = { x, y, z, w, h, l, filename };
+    UCreateCubes(&box, 1);
+}
+
+/* 
+Creates a plane with the rule that point 1 and point 3 are on the opposite sides of the square.
+The edges go as 1-2-3 and 1-4-3.  It should look like:
+    1 ---- 2
+    |      |
+    |      |
+    4 ---- 3
+*/
+void UCreatePlane(
+    float x1, float y1, float z1, 
+    float x2, float y2, float z2,
+    float x3, float y3, float z3,
+    float x4, float y4, float z4, const char* filename)
+{
+    PlaneParams plane = { { glm::vec3(x1, y1, z1), glm::vec3(x2, y2, z2), glm::vec3(x3, y3, z3), glm::vec3(x4, y4, z4) }, filename };
+    UCreatePlanes(&plane, 1);
+}
+
+// Creates a square pyramid
+void UCreatePyramid(float x, float y, float z, float w, float h, float l, const char* filename)
+{
+    PyramidParams pyramid = { x, y, z, w, h, l, filename };
+    UCreatePyramids(&pyramid, 1);
+}
+
+/* Describe each primitive kind to UCreatePrimitives:
+ * its name for statistics, whether it is worth reordering for the vertex caches, its level count,
+ * the vertex and index count and error of each level, and how to generate a level.
+ * Boxes, pyramids and planes are a few unshared triangles, so there is no vertex reuse to gain from reordering them.
+ */
+struct BoxShape
+{
+    static const char* name() { return "cubes"; }
+    static bool reorder() { return false; }
+    static GLuint nLods(const BoxParams&) { return 1; }
+    static GLuint nVertices(const BoxParams&, GLuint) { return BOX_VERTEX_COUNT; }
+    static GLuint nIndices(const BoxParams&, GLuint) { return BOX_VERTEX_COUNT; }
+    static float error(const BoxParams&, GLuint) { return 0.0f; }
+    static void generate(const BoxParams& p, GLuint, GLfloat* verts, GLuint* indices) { GenerateBox(p.x, p.y, p.z, p.w, p.h, p.l, verts, indices); }
+};
+
+struct PyramidShape
+{
+    static const char* name() { return "pyramids"; }
+    static bool reorder() { return false; }
+    static GLuint nLods(const PyramidParams&) { return 1; }
+    static GLuint nVertices(const PyramidParams&, GLuint) { return PYRAMID_VERTEX_COUNT; }
+    static GLuint nIndices(const PyramidParams&, GLuint) { return PYRAMID_VERTEX_COUNT; }
+    static float error(const PyramidParams&, GLuint) { return 0.0f; }
+    static void generate(const PyramidParams& p, GLuint, GLfloat* verts, GLuint* indices) { GeneratePyramid(p.x, p.y, p.z, p.w, p.h, p.l, verts, indices); }
+};
+
+struct PlaneShape
+{
+    static const char* name() { return "planes"; }
+    static bool reorder() { return false; }
+    static GLuint nLods(const PlaneParams&) { return 1; }
+    static GLuint nVertices(const PlaneParams&, GLuint) { return PLANE_VERTEX_COUNT; }
+    static GLuint nIndices(const PlaneParams&, GLuint) { return PLANE_VERTEX_COUNT; }
+    static float error(const PlaneParams&, GLuint) { return 0.0f; }
+    static void generate(const PlaneParams& p, GLuint, GLfloat* verts, GLuint* indices) { GeneratePlane(p.corners, verts, indices); }
+};
+
+// Each cylinder level halves the edge count of the previous one, down to a triangular prism
+struct CylinderShape
+{
+    static const char* name() { return "cylinders"; }
+    static bool reorder() { return true; }
+    static GLuint edges(const CylinderParams& p, GLuint lod) { return std::max(p.nEdges >> lod, 3u); }
+    static GLuint nLods(const CylinderParams& p) { return std::min(std::max(p.nLods, 1u), MAX_MESH_LODS); }
+    static GLuint nVertices(const CylinderParams& p, GLuint lod) { return CylinderVertexCount(edges(p, lod), p.capped); }
+    static GLuint nIndices(const CylinderParams& p, GLuint lod) { return CylinderIndexCount(edges(p, lod), p.capped); }
+    static float error(const CylinderParams& p, GLuint lod) { return CylinderTessellationError(p.r, edges(p, lod)); }
+    static void generate(const CylinderParams& p, GLuint lod, GLfloat* verts, GLuint* indices) { GenerateCylinder(p.x, p.y, p.z, p.r, p.h, edges(p, lod), p.capped, verts, indices); }
+};
+
+/* Creates count primitives in one pass and returns their mesh indices.
+ * The staging buffers are sized once, then worker threads generate each primitive straight into its own slot.
+ * The float layout is written in place; the packed layout goes through a per-thread scratch buffer.
+ */
+template <typename Params, typename Shape>
+vector<GLuint> UCreatePrimitives(const Params* params, size_t count)
+{
+    const GLuint stride = gPackedVertices ? sizeof(PackedVertex) : sizeof(GLfloat) * FLOATS_PER_VERTEX;
+    gGeometry.vertexStride = stride;
+
+    // Lay out every level of every primitive; textures are resolved here because GL calls must stay on this thread
+    size_t firstMesh = gMeshVector.size();
+    size_t nVertices = gGeometry.vertices.size() / stride;
+    size_t nIndices = gGeometry.indices.size();
+    GLuint maxVertices = 0;
+    vector<GLuint> handles(count);
+    gMeshVector.resize(firstMesh + count);
+    for (size_t i = 0; i < count; i++)
+    {
+        GLMesh& mesh = gMeshVector[firstMesh + i];
+        mesh.textureId = UGetTexture(params[i].filename);
+        mesh.nLods = Shape::nLods(params[i]);
+        for (GLuint lod = 0; lod < mesh.nLods; lod++)
+        {
+            GLMeshLod& level = mesh.lods[lod];
+            level.baseVertex = nVertices;
+            level.firstIndex = nIndices;
+            level.nIndices = Shape::nIndices(params[i], lod);
+            level.error = Shape::error(params[i], lod);
+
+            GLuint levelVertices = Shape::nVertices(params[i], lod);
+            maxVertices = std::max(maxVertices, levelVertices);
+            nVertices += levelVertices;
+            nIndices += level.nIndices;
+        }
+        handles[i] = firstMesh + i;
+    }
+    gGeometry.vertices.resize(nVertices * stride);
+    gGeometry.indices.resize(nIndices);
+
+    mutex statsMutex;
+    VertexCacheTotals totals;
+    auto generate = [&](size_t begin, size_t end)
+    {
+        vector<GLfloat> scratch(gPackedVertices ? maxVertices * FLOATS_PER_VERTEX : 0);
+        for (size_t i = begin; i < end; i++)
+        {
+            GLMesh& mesh = gMeshVector[firstMesh + i];
+            for (GLuint lod = 0; lod < mesh.nLods; lod++)
+            {
+                const GLMeshLod& level = mesh.lods[lod];
+                GLuint levelVertices = Shape::nVertices(params[i], lod);
+                unsigned char* staged = &gGeometry.vertices[(size_t)level.baseVertex * stride];
+                GLfloat* verts = gPackedVertices ? scratch.data() : (GLfloat*)staged;
+                GLuint* indices = &gGeometry.indices[level.firstIndex];
+                Shape::generate(params[i], lod, verts, indices);
+
+                // Generated levels reference every vertex, so reordering keeps the counts laid out above
+                if (gOptimizeMeshes && Shape::reorder())
+                {
+                    VertexCacheStats before, after;
+                    if (gMeshStats)
+                        before = AnalyzeVertexCache(indices, level.nIndices, levelVertices);
+                    OptimizeMeshOrder(verts, levelVertices, indices, level.nIndices);
+                    if (gMeshStats)
+                    {
+                        after = AnalyzeVertexCache(indices, level.nIndices, levelVertices);
+                        lock_guard<mutex> lock(statsMutex);
+                        totals.add(before, after, level.nIndices / 3, levelVertices);
+                    }
+                }
+
+                // Bounds come from the most detailed level and are shared by the coarser ones
+                if (lod == 0)
+                    UComputeBounds(verts, levelVertices, mesh);
+
+                if (gPackedVertices)
+                {
+                    glm::vec3 boundsExtent = mesh.boundsMax - mesh.boundsMin;
+                    PackedVertex* packed = (PackedVertex*)staged;
+                    for (GLuint v = 0; v < levelVertices; v++)
+                        packed[v] = PackVertex(verts + v * FLOATS_PER_VERTEX, mesh.boundsMin, boundsExtent);
+                }
+            }
+        }
+    };
+
+    // Small batches are not worth a thread
+    const size_t minPerThread = 256;
+    size_t nThreads = std::max<size_t>(1, std::min<size_t>(thread::hardware_concurrency(), count / minPerThread));
+    size_t perThread = (count + nThreads - 1) / nThreads;
+    vector<thread> workers;
+    for (size_t t = 1; t < nThreads; t++)
+        workers.emplace_back(generate, std::min(count, t * perThread), std::min(count, (t + 1) * perThread));
+    generate(0, std::min(count, perThread));
+    for (thread& worker : workers)
+        worker.join();
+
+    if (gOptimizeMeshes && Shape::reorder() && gMeshStats && count)
+        UPrintCacheStats(string(Shape::name()) + " (" + to_string(count) + ")", totals.before(), totals.after());
+
+    return handles;
+}
+
+vector<GLuint> UCreateCubes(const BoxParams* boxes, size_t count)
+{
+    return UCreatePrimitives<BoxParams, BoxShape>(boxes, count);
+}
+
+vector<GLuint> UCreatePyramids(const PyramidParams* pyramids, size_t count)
+{
+    return UCreatePrimitives<PyramidParams, PyramidShape>(pyramids, count);
+}
+
+vector<GLuint> UCreatePlanes(const PlaneParams* planes, size_t count)
+{
+    return UCreatePrimitives<PlaneParams, PlaneShape>(planes, count);
+}
+
+vector<GLuint> UCreateCylinders(const CylinderParams* cylinders, size_t count)
+{
+    return UCreatePrimitives<CylinderParams, CylinderShape>(cylinders, count);
+}
+
+bool UReadScene(const char* path, Scene& scene)
+{
+    ifstream file(path);
+    if (!file)
+    {
+        cout << "Failed to open scene " << path << endl;
+        return false;
+    }
+
+    if (!ParseScene(file, scene))
+    {
+        cout << "Failed to parse scene " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+// Creates a scene's meshes, one batch per primitive kind. Textures resolve through UGetTexture.
+void UCreateSceneMeshes(const Scene& scene)
+{
+    vector<BoxParams> cubes(scene.cubes.size());
+    for (size_t i = 0; i < cubes.size(); i++)
+    {
+        const SceneBox& box = scene.cubes[i];
+        cubes[i] = { box.position.x, box.position.y, box.position.z, box.size.x, box.size.y, box.size.z, scene.textures[box.texture].c_str() };
+    }
+
+    vector<PyramidParams> pyramids(scene.pyramids.size());
+    for (size_t i = 0; i < pyramids.size(); i++)
+    {
+        const SceneBox& box = scene.pyramids[i];
+        pyramids[i] = { box.position.x, box.position.y, box.position.z, box.size.x, box.size.y, box.size.z, scene.textures[box.texture].c_str() };
+    }
+
+    vector<PlaneParams> planes(scene.planes.size());
+    for (size_t i = 0; i < planes.size(); i++)
+    {
+        const ScenePlane& plane = scene.planes[i];
+        planes[i] = { { plane.corners[0], plane.corners[1], plane.corners[2], plane.corners[3] }, scene.textures[plane.texture].c_str() };
+    }
+
+    vector<CylinderParams> cylinders(scene.cylinders.size());
+    for (size_t i = 0; i < cylinders.size(); i++)
+    {
+        const SceneCylinder& cylinder = scene.cylinders[i];
+        cylinders[i] = { cylinder.position.x, cylinder.position.y, cylinder.position.z, cylinder.radius, cylinder.height,
+                         scene.textures[cylinder.texture].c_str(), cylinder.edges, cylinder.capped, cylinder.lods };
+    }
+
+    vector<GLuint> cubeMeshes = UCreateCubes(cubes.data(), cubes.size());
+    for (size_t i = 0; i < cubeMeshes.size(); i++)
+        gMeshVector[cubeMeshes[i]].occluder = scene.cubes[i].occluder;
+    UCreatePyramids(pyramids.data(), pyramids.size());
+    UCreatePlanes(planes.data(), planes.size());
+    UCreateCylinders(cylinders.data(), cylinders.size());
+
+    for (const SceneModel& model : scene.models)
+        UImportModel(model.path.c_str(), glm::translate(model.position) * glm::scale(glm::vec3(model.scale)), model.lods);
+}
+
+/* Imports an OBJ or binary glTF model as indexed meshes, one per material or primitive.
+ * Texture files are loaded through the shared cache, embedded images are cached under "<model>#<image>".
+ */
+bool UImportModel(const char* path, const glm::mat4& transform, GLuint nLods)
+{
+    string extension = path;
+    extension = extension.substr(extension.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+
+    ImportedModel model;
+    bool imported = false;
+    if (extension == "obj")
+        imported = ImportObj(path, transform, model);
+    else if (extension == "glb")
+        imported = ImportGlb(path, transform, model);
+    else
+        cout << "Unsupported model format " << path << endl;
+    if (!imported)
+        return false;
+
+    vector<string> files;
+    for (const ImportedMesh& mesh : model.meshes)
+    {
+        if (!mesh.texture.empty())
+            files.push_back(mesh.texture);
+    }
+    UPreloadTextures(files);
+
+    size_t nTriangles = 0;
+    for (const ImportedMesh& mesh : model.meshes)
+    {
+        GLuint textureId = 0;
+        if (mesh.image >= 0)
+        {
+            const ImportedImage& image = model.images[mesh.image];
+            textureId = UGetTextureFromMemory(string(path) + "#" + to_string(mesh.image), image.data, image.size);
+        }
+        else if (!mesh.texture.empty())
+            textureId = UGetTexture(mesh.texture.c_str());
+
+        if (mesh.vertices.empty() || mesh.nIndices == 0)
+            continue;
+        GLuint nVertices = mesh.vertices.size() / FLOATS_PER_VERTEX;
+        UAddTexturedMesh(mesh.vertices.data(), nVertices, mesh.indices, mesh.nIndices, textureId, 0.0f, nLods);
+        nTriangles += mesh.nIndices / 3;
+    }
+
+    cout << "Imported " << path << ": " << model.meshes.size() << " meshes, " << nTriangles << " triangles" << endl;
+    return true;
+}
+
+/* Reads a scene file and creates its meshes.
+ * Each texture file is loaded once however many primitives use it, and each primitive kind is created in one batch.
+ */
+bool ULoadScene(const char* path)
+{
+    Scene scene;
+    if (!UReadScene(path, scene))
+        return false;
+
+    UPreloadTextures(scene.textures);
+    for (size_t t = 0; t < scene.textures.size(); t++)
+    {
+        auto texture = gTextureCache.find(scene.textures[t]);
+        if (texture != gTextureCache.end() && texture->second != 0 && scene.textureLighting[t] != SCENE_LIGHTING_PHONG)
+            gTextureLighting[texture->second] = scene.textureLighting[t];
+    }
+    UCreateSceneMeshes(scene);
+
+    cout << "Loaded scene " << path << ": " << gMeshVector.size() << " meshes, " << scene.textures.size() << " textures" << endl;
+    return true;
+}
+
+/* Bakes a scene into one archive that ULoadArchive can map and upload as is.
+ * Textures are decoded and mipped here instead of at startup. The bake is incremental: a texture whose source
+ * hash matches the previous archive is copied from it, and so is the geometry when neither the scene file
+ * nor any model it imports changed.
+ */
+bool UBakeArchive(const char* scenePath, const char* archivePath)
+{
+    gGeometry.vertexStride = gPackedVertices ? sizeof(PackedVertex) : sizeof(GLfloat) * FLOATS_PER_VERTEX;
+
+    MappedFile sceneFile;
+    Scene scene;
+    if (!sceneFile.open(scenePath) || !UReadScene(scenePath, scene))
+    {
+        cout << "Failed to bake " << scenePath << endl;
+        return false;
+    }
+    uint64_t sceneHash = HashBytes(sceneFile.data(), sceneFile.size(), HashBytes(&gGeometry.vertexStride, sizeof(gGeometry.vertexStride)));
+    sceneHash = HashBytes(&gOptimizeMeshes, sizeof(gOptimizeMeshes), sceneHash);
+
+    // The previous archive, if it is still readable, supplies everything that did not change
+    MappedFile previous;
+    const ArchiveHeader* old = nullptr;
+    if (previous.open(archivePath) && UValidateArchive(previous))
+        old = (const ArchiveHeader*)previous.data();
+    const ArchiveTexture* oldTextures = old ? (const ArchiveTexture*)(previous.data() + old->textureOffset) : nullptr;
+
+    // Geometry is regenerated only when the scene, a model it imports or the vertex layout changed.
+    // Material libraries next to an OBJ are not tracked, a clean bake picks up edits to them.
+    for (const SceneModel& model : scene.models)
+    {
+        MappedFile modelFile;
+        sceneHash = modelFile.open(model.path.c_str()) ? HashBytes(modelFile.data(), modelFile.size(), sceneHash) : HashBytes("", 0, sceneHash + 1);
+    }
+
+    struct BakedTexture
+    {
+        string name;                           // File path, or model path and image index for embedded images
+        bool embedded;
+        vector<unsigned char> encoded;         // Embedded image bytes, only when the geometry was regenerated
+        uint64_t sourceHash;
+        uint32_t channels;
+        vector<ArchiveLevel> levels;           // Sizes, offsets are assigned while writing
+        vector<const unsigned char*> sources;  // Pixels of each level
+        vector<vector<unsigned char>> pixels;  // Storage for levels decoded by this bake
+    };
+    vector<BakedTexture> textures;
+
+    vector<ArchiveMesh> meshes;
+    const unsigned char* vertexData = nullptr;
+    const unsigned char* indexData = nullptr;
+    uint64_t vertexSize = 0;
+    uint64_t indexSize = 0;
+    bool geometryReused = old && old->sceneHash == sceneHash;
+    if (geometryReused)
+    {
+        const ArchiveMesh* oldMeshes = (const ArchiveMesh*)(previous.data() + old->meshOffset);
+        meshes.assign(oldMeshes, oldMeshes + old->nMeshes);
+        vertexData = previous.data() + old->vertexOffset;
+        vertexSize = old->vertexSize;
+        indexData = previous.data() + old->indexOffset;
+        indexSize = old->indexSize;
+
+        // The meshes keep their texture slots, so the texture list is the previous one
+        textures.resize(old->nTextures);
+        for (uint32_t t = 0; t < old->nTextures; t++)
+        {
+            textures[t].name.assign((const char*)previous.data() + old->pathOffset + oldTextures[t].pathOffset, oldTextures[t].pathLength);
+            textures[t].embedded = oldTextures[t].embedded != 0;
+        }
+    }
+    else
+    {
+        // Textures are handed out as slots instead of being loaded, so creating the meshes never touches GL
+        gDeferTextures = true;
+        UCreateSceneMeshes(scene);
+        gDeferTextures = false;
+
+        textures.resize(gDeferredTextures.size());
+        for (size_t t = 0; t < gDeferredTextures.size(); t++)
+        {
+            textures[t].name = gDeferredTextures[t];
+            auto image = gDeferredImages.find((GLuint)t + 1);
+            textures[t].embedded = image != gDeferredImages.end();
+            if (textures[t].embedded)
+                textures[t].encoded = std::move(image->second);
+        }
+        gTextureCache.clear();
+        gDeferredTextures.clear();
+        gDeferredImages.clear();
+
+        meshes.resize(gMeshVector.size());
+        for (size_t i = 0; i < gMeshVector.size(); i++)
+        {
+            const GLMesh& mesh = gMeshVector[i];
+            ArchiveMesh& baked = meshes[i];
+            memset(&baked, 0, sizeof(baked));
+            for (GLuint lod = 0; lod < mesh.nLods; lod++)
+                baked.lods[lod] = { mesh.lods[lod].baseVertex, mesh.lods[lod].firstIndex, mesh.lods[lod].nIndices, mesh.lods[lod].error };
+            baked.nLods = mesh.nLods;
+            baked.texture = mesh.textureId == 0 ? ARCHIVE_NO_TEXTURE : mesh.textureId - 1;
+            memcpy(baked.boundsMin, &mesh.boundsMin[0], sizeof(baked.boundsMin));
+            memcpy(baked.boundsMax, &mesh.boundsMax[0], sizeof(baked.boundsMax));
+            memcpy(baked.sphere, &mesh.sphereCenter[0], sizeof(float) * 3);
+            baked.sphere[3] = mesh.sphereRadius;
+            baked.flags = mesh.occluder ? ARCHIVE_MESH_OCCLUDER : 0;
+        }
+        vertexData = gGeometry.vertices.data();
+        vertexSize = gGeometry.vertices.size();
+        indexData = (const unsigned char*)gGeometry.indices.data();
+        indexSize = gGeometry.indices.size() * sizeof(GLuint);
+    }
+
+    // A texture whose source bytes hash the same as in the previous archive is copied from it
+    vector<size_t> rebuild;
+    for (size_t i = 0; i < textures.size(); i++)
+    {
+        BakedTexture& texture = textures[i];
+        texture.channels = 0;
+        texture.sourceHash = 0;
+        if (geometryReused && texture.embedded)
+            texture.sourceHash = oldTextures[i].sourceHash; // Unchanged with the model that holds it
+        else if (texture.embedded)
+            texture.sourceHash = HashBytes(texture.encoded.data(), texture.encoded.size());
+        else
+        {
+            MappedFile source;
+            if (source.open(texture.name.c_str()))
+                texture.sourceHash = HashBytes(source.data(), source.size());
+        }
+
+        const ArchiveTexture* match = nullptr;
+        for (uint32_t t = 0; old && t < old->nTextures; t++)
+        {
+            const char* oldPath = (const char*)previous.data() + old->pathOffset + oldTextures[t].pathOffset;
+            if (oldTextures[t].sourceHash == texture.sourceHash && texture.name.compare(0, string::npos, oldPath, oldTextures[t].pathLength) == 0)
+                match = &oldTextures[t];
+        }
+
+        if (match)
+        {
+            texture.channels = match->channels;
+            for (uint32_t level = 0; level < match->nLevels; level++)
+            {
+                texture.levels.push_back(match->levels[level]);
+                texture.sources.push_back(previous.data() + match->levels[level].offset);
+            }
+        }
+        else
+            rebuild.push_back(i);
+    }
+
+    // Changed textures are decoded and mipped in parallel, they share no state
+    size_t nThreads = std::max<size_t>(1, std::min<size_t>(thread::hardware_concurrency(), rebuild.size()));
+    vector<thread> workers;
+    for (size_t t = 0; t < nThreads; t++)
+    {
+        workers.emplace_back([&, t]()
+        {
+            for (size_t r = t; r < rebuild.size(); r += nThreads)
+            {
+                BakedTexture& texture = textures[rebuild[r]];
+                DecodedImage image;
+                bool decoded = texture.embedded ? UDecodeTextureFromMemory(texture.encoded.data(), texture.encoded.size(), image)
+                                                : UDecodeTexture(texture.name.c_str(), image);
+                if (!decoded)
+                    continue;
+
+                if (image.channels == 3 || image.channels == 4)
+                {
+                    texture.channels = image.channels;
+                    texture.pixels.emplace_back(image.pixels, image.pixels + (size_t)image.width * image.height * image.channels);
+
+                    uint32_t width = image.width;
+                    uint32_t height = image.height;
+                    while (true)
+                    {
+                        texture.levels.push_back({ 0, texture.pixels.back().size(), width, height });
+                        if ((width == 1 && height == 1) || texture.levels.size() == ARCHIVE_MAX_LEVELS)
+                            break;
+
+                        vector<unsigned char> next;
+                        DownsampleLevel(texture.pixels.back().data(), width, height, texture.channels, next);
+                        texture.pixels.push_back(std::move(next));
+                        width = width > 1 ? width / 2 : 1;
+                        height = height > 1 ? height / 2 : 1;
+                    }
+                    for (const vector<unsigned char>& level : texture.pixels)
+                        texture.sources.push_back(level.data());
+                }
+                stbi_image_free(image.pixels);
+            }
+        });
+    }
+    for (thread& worker : workers)
+        worker.join();
+
+    for (size_t i : rebuild)
+    {
+        if (textures[i].levels.empty())
+            cout << "Failed to load texture " << textures[i].name << endl;
+    }
+
+    // Written beside the old archive first, since the old one is still mapped and being copied from
+    string tempPath = string(archivePath) + ".tmp";
+    ofstream out(tempPath, ios::binary | ios::trunc);
+    if (!out)
+    {
+        cout << "Failed to write " << tempPath << endl;
+        return false;
+    }
+
+    ArchiveHeader header;
+    memset(&header, 0, sizeof(header));
+    out.write((const char*)&header, sizeof(header));
+
+    auto writeBlob = [&](const void* data, uint64_t size)
+    {
+        static const char padding[ARCHIVE_ALIGNMENT] = {};
+        uint64_t offset = (uint64_t)out.tellp();
+        uint64_t aligned = AlignArchiveOffset(offset);
+        out.write(padding, aligned - offset);
+        out.write((const char*)data, size);
+        return aligned;
+    };
+
+    header.vertexOffset = writeBlob(vertexData, vertexSize);
+    header.vertexSize = vertexSize;
+    header.indexOffset = writeBlob(indexData, indexSize);
+    header.indexSize = indexSize;
+
+    // Model textures are not declared by the scene and stay Phong
+    unordered_map<string, SceneLighting> lighting;
+    for (size_t t = 0; t < scene.textures.size(); t++)
+        lighting[scene.textures[t]] = scene.textureLighting[t];
+
+    vector<ArchiveTexture> textureTable(textures.size());
+    string paths;
+    for (size_t i = 0; i < textures.size(); i++)
+    {
+        ArchiveTexture& record = textureTable[i];
+        memset(&record, 0, sizeof(record));
+        record.sourceHash = textures[i].sourceHash;
+        record.pathOffset = (uint32_t)paths.size();
+        record.pathLength = (uint32_t)textures[i].name.size();
+        record.channels = textures[i].channels;
+        record.embedded = textures[i].embedded;
+        auto declared = lighting.find(textures[i].name);
+        record.lighting = declared == lighting.end() || textures[i].embedded ? SCENE_LIGHTING_PHONG : declared->second;
+        record.nLevels = (uint32_t)textures[i].levels.size();
+        for (uint32_t level = 0; level < record.nLevels; level++)
+        {
+            record.levels[level] = textures[i].levels[level];
+            record.levels[level].offset = writeBlob(textures[i].sources[level], record.levels[level].size);
+        }
+        paths += textures[i].name;
+    }
+
+    header.meshOffset = writeBlob(meshes.data(), meshes.size() * sizeof(ArchiveMesh));
+    header.textureOffset = writeBlob(textureTable.data(), textureTable.size() * sizeof(ArchiveTexture));
+    header.pathOffset = writeBlob(paths.data(), paths.size());
+    header.pathSize = paths.size();
+
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+    header.version = ARCHIVE_VERSION;
+    header.vertexStride = gGeometry.vertexStride;
+    header.sceneHash = sceneHash;
+    header.nMeshes = (uint32_t)meshes.size();
+    header.nTextures = (uint32_t)textureTable.size();
+    out.seekp(0);
+    out.write((const char*)&header, sizeof(header));
+    out.close();
+    if (!out)
+    {
+        cout << "Failed to write " << tempPath << endl;
+        return false;
+    }
+
+    previous.close();
+    remove(archivePath);
+    if (rename(tempPath.c_str(), archivePath) != 0)
+    {
+        cout << "Failed to replace " << archivePath << endl;
+        return false;
+    }
+
+    cout << "Baked " << archivePath << ": " << meshes.size() << " meshes (" << (geometryReused ? "unchanged" : "rebuilt") << "), "
+         << textures.size() << " textures (" << rebuild.size() << " rebuilt)" << endl;
+    return true;
+}
+
+// Checks that every table and blob an archive references lies inside the file
+bool UValidateArchive(const MappedFile& archive)
+{
+    if (!archive.contains(0, sizeof(ArchiveHeader)))
+        return false;
+
+    const ArchiveHeader* header = (const ArchiveHeader*)archive.data();
+    if (memcmp(header->magic, ARCHIVE_MAGIC, sizeof(header->magic)) != 0 || header->version != ARCHIVE_VERSION)
+        return false;
+
+    if (!archive.contains(header->meshOffset, (uint64_t)header->nMeshes * sizeof(ArchiveMesh))
+        || !archive.contains(header->textureOffset, (uint64_t)header->nTextures * sizeof(ArchiveTexture))
+        || !archive.contains(header->pathOffset, header->pathSize)
+        || !archive.contains(header->vertexOffset, header->vertexSize)
+        || !archive.contains(header->indexOffset, header->indexSize)
+        || header->vertexStride == 0)
+        return false;
+
+    const ArchiveTexture* textures = (const ArchiveTexture*)(archive.data() + header->textureOffset);
+    for (uint32_t i = 0; i < header->nTextures; i++)
+    {
+        const ArchiveTexture& texture = textures[i];
+        if ((uint64_t)texture.pathOffset + texture.pathLength > header->pathSize || texture.nLevels > ARCHIVE_MAX_LEVELS)
+            return false;
+        if (texture.nLevels > 0 && texture.channels != 3 && texture.channels != 4)
+            return false;
+        for (uint32_t level = 0; level < texture.nLevels; level++)
+        {
+            const ArchiveLevel& data = texture.levels[level];
+            if (!archive.contains(data.offset, data.size) || data.size != (uint64_t)data.width * data.height * texture.channels)
+                return false;
+        }
+    }
+
+    // Every index of a level, offset by its base vertex, must land inside the vertex data
+    const ArchiveMesh* meshes = (const ArchiveMesh*)(archive.data() + header->meshOffset);
+    const GLuint* indices = (const GLuint*)(archive.data() + header->indexOffset);
+    uint64_t nIndices = header->indexSize / sizeof(GLuint);
+    uint64_t nVertices = header->vertexSize / header->vertexStride;
+    for (uint32_t i = 0; i < header->nMeshes; i++)
+    {
+        const ArchiveMesh& mesh = meshes[i];
+        if ((mesh.texture >= header->nTextures && mesh.texture != ARCHIVE_NO_TEXTURE) || mesh.nLods == 0 || mesh.nLods > MAX_MESH_LODS)
+            return false;
+        for (uint32_t lod = 0; lod < mesh.nLods; lod++)
+        {
+            const ArchiveLod& level = mesh.lods[lod];
+            if ((uint64_t)level.firstIndex + level.nIndices > nIndices || level.baseVertex >= nVertices)
+                return false;
+
+            GLuint maxIndex = 0;
+            for (uint32_t index = 0; index < level.nIndices; index++)
+                maxIndex = std::max(maxIndex, indices[level.firstIndex + index]);
+            if ((uint64_t)level.baseVertex + maxIndex >= nVertices)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/* Maps a baked archive and uploads it straight from the mapped pages: no decoding, no generation,
+ * and no per-asset file access. Returns false, leaving nothing created, if the archive is unusable.
+ */
+bool ULoadArchive(const char* path)
+{
+    MappedFile archive;
+    if (!archive.open(path) || !UValidateArchive(archive))
+    {
+        cout << "Failed to load archive " << path << endl;
+        return false;
+    }
+
+    const ArchiveHeader* header = (const ArchiveHeader*)archive.data();
+    GLuint vertexStride = gPackedVertices ? sizeof(PackedVertex) : sizeof(GLfloat) * FLOATS_PER_VERTEX;
+    if (header->vertexStride != vertexStride)
+    {
+        cout << "Archive " << path << " was baked for the other vertex layout" << endl;
+        return false;
+    }
+
+    // Mip levels are tightly packed, so rows are not padded to four bytes
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    const ArchiveTexture* textures = (const ArchiveTexture*)(archive.data() + header->textureOffset);
+    const char* paths = (const char*)archive.data() + header->pathOffset;
+    vector<GLuint> textureIds(header->nTextures, 0);
+    for (uint32_t i = 0; i < header->nTextures; i++)
+    {
+        const ArchiveTexture& texture = textures[i];
+        if (texture.nLevels > 0)
+        {
+            glCreateTextures(GL_TEXTURE_2D, 1, &textureIds[i]);
+
+            glTextureParameteri(textureIds[i], GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTextureParameteri(textureIds[i], GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTextureParameteri(textureIds[i], GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTextureParameteri(textureIds[i], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+            GLenum format = texture.channels == 3 ? GL_RGB : GL_RGBA;
+            glTextureStorage2D(textureIds[i], texture.nLevels, texture.channels == 3 ? GL_RGB8 : GL_RGBA8, texture.levels[0].width, texture.levels[0].height);
+            for (uint32_t level = 0; level < texture.nLevels; level++)
+            {
+                const ArchiveLevel& data = texture.levels[level];
+                glTextureSubImage2D(textureIds[i], level, 0, 0, data.width, data.height, format, GL_UNSIGNED_BYTE, archive.data() + data.offset);
+            }
+        }
+        gTextureCache[string(paths + texture.pathOffset, texture.pathLength)] = textureIds[i];
+        if (textureIds[i] != 0 && texture.lighting != SCENE_LIGHTING_PHONG)
+            gTextureLighting[textureIds[i]] = texture.lighting <= SCENE_LIGHTING_UNLIT ? (SceneLighting)texture.lighting : SCENE_LIGHTING_PHONG;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    const ArchiveMesh* meshes = (const ArchiveMesh*)(archive.data() + header->meshOffset);
+    gMeshVector.resize(header->nMeshes);
+    for (uint32_t i = 0; i < header->nMeshes; i++)
+    {
+        const ArchiveMesh& baked = meshes[i];
+        GLMesh& mesh = gMeshVector[i];
+        for (uint32_t lod = 0; lod < baked.nLods; lod++)
+            mesh.lods[lod] = { baked.lods[lod].baseVertex, baked.lods[lod].firstIndex, baked.lods[lod].nIndices, baked.lods[lod].error };
+        mesh.nLods = baked.nLods;
+        mesh.textureId = baked.texture == ARCHIVE_NO_TEXTURE ? 0 : textureIds[baked.texture];
+        mesh.boundsMin = glm::vec3(baked.boundsMin[0], baked.boundsMin[1], baked.boundsMin[2]);
+        mesh.boundsMax = glm::vec3(baked.boundsMax[0], baked.boundsMax[1], baked.boundsMax[2]);
+        mesh.sphereCenter = glm::vec3(baked.sphere[0], baked.sphere[1], baked.sphere[2]);
+        mesh.sphereRadius = baked.sphere[3];
+        mesh.occluder = (baked.flags & ARCHIVE_MESH_OCCLUDER) != 0;
+    }
+
+    gGeometry.vertexStride = header->vertexStride;
+    UUploadGeometry(archive.data() + header->vertexOffset, header->vertexSize,
+                    (const GLuint*)(archive.data() + header->indexOffset), header->indexSize / sizeof(GLuint));
+
+    cout << "Loaded archive " << path << ": " << header->nMeshes << " meshes, " << header->nTextures << " textures" << endl;
+    return true;
+}
+
+/* Computes a mesh's axis aligned bounds and bounding sphere from a run of full layout vertices.
+ * The sphere is centered on the box, with the radius reaching the farthest vertex rather than the box corners.
+ */
+void UComputeBounds(const GLfloat* verts, GLuint nVertices, GLMesh& mesh)
+{
+    mesh.boundsMin = glm::vec3(verts[0], verts[1], verts[2]);
+    mesh.boundsMax = mesh.boundsMin;
+    for (GLuint i = 1; i < nVertices; i++)
+    {
+        const GLfloat* vert = verts + i * FLOATS_PER_VERTEX;
+        mesh.boundsMin = glm::min(mesh.boundsMin, glm::vec3(vert[0], vert[1], vert[2]));
+        mesh.boundsMax = glm::max(mesh.boundsMax, glm::vec3(vert[0], vert[1], vert[2]));
+    }
+
+    mesh.sphereCenter = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+    float radiusSquared = 0.0f;
+    for (GLuint i = 0; i < nVertices; i++)
+    {
+        const GLfloat* vert = verts + i * FLOATS_PER_VERTEX;
+        glm::vec3 offset = glm::vec3(vert[0], vert[1], vert[2]) - mesh.sphereCenter;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    mesh.sphereRadius = sqrt(radiusSquared);
+}
+
+// Prints one line of vertex cache statistics for --mesh-stats
+void UPrintCacheStats(const string& label, const VertexCacheStats& before, const VertexCacheStats& after)
+{
+    streamsize precision = cout.precision(3);
+    cout << label << ": ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << endl;
+    cout.precision(precision);
+}
+
+// Appends a mesh's vertices to the shared geometry, packing them if requested, and returns the first one's index
+GLuint UStageVertices(const GLMesh& mesh, const GLfloat* verts, GLuint nVertices)
+{
+    gGeometry.vertexStride = gPackedVertices ? sizeof(PackedVertex) : sizeof(GLfloat) * FLOATS_PER_VERTEX;
+
+    GLuint baseVertex = gGeometry.vertices.size() / gGeometry.vertexStride;
+    size_t offset = gGeometry.vertices.size();
+    gGeometry.vertices.resize(offset + nVertices * gGeometry.vertexStride);
+
+    if (gPackedVertices)
+    {
+        // Positions are quantized across the mesh's own bounds
+        glm::vec3 boundsExtent = mesh.boundsMax - mesh.boundsMin;
+        PackedVertex* packed = (PackedVertex*)&gGeometry.vertices[offset];
+        for (GLuint i = 0; i < nVertices; i++)
+            packed[i] = PackVertex(verts + i * FLOATS_PER_VERTEX, mesh.boundsMin, boundsExtent);
+    }
+    else
+        memcpy(&gGeometry.vertices[offset], verts, nVertices * gGeometry.vertexStride);
+
+    return baseVertex;
+}
+
+/* Appends a level's indices to the shared geometry. Every level of a mesh draws from the vertices staged for its
+ * most detailed one, so the coarser levels only reorder their triangles instead of going through the whole optimizer.
+ */
+GLMeshLod UStageLod(GLuint meshIndex, const GLMesh& mesh, GLuint baseVertex, const GLfloat* verts, GLuint nVertices, const GLuint* indices, GLuint nIndices, float lodError)
+{
+    GLMeshLod lod;
+    lod.baseVertex = baseVertex;
+    lod.firstIndex = gGeometry.indices.size();
+    lod.nIndices = nIndices;
+    lod.error = lodError;
+
+    gGeometry.indices.insert(gGeometry.indices.end(), indices, indices + nIndices);
+    if (gOptimizeMeshes && mesh.nLods > 0)
+    {
+        GLuint* staged = &gGeometry.indices[lod.firstIndex];
+        VertexCacheStats before;
+        if (gMeshStats)
+            before = AnalyzeVertexCache(staged, nIndices, nVertices);
+        OptimizeIndexOrder(verts, nVertices, staged, nIndices);
+        if (gMeshStats)
+            UPrintCacheStats("Mesh " + to_string(meshIndex) + " LOD " + to_string(mesh.nLods), before, AnalyzeVertexCache(staged, nIndices, nVertices));
+    }
+
+    return lod;
+}
+
+/* Creates a mesh from its most detailed level and returns its index.
+ * Without indices the vertices are treated as a plain triangle list.
+ */
+GLuint UAddMesh(const GLfloat* verts, GLuint nVertices, const GLuint* indices, GLuint nIndices, const char* filename, float lodError)
+{
+    return UAddTexturedMesh(verts, nVertices, indices, nIndices, UGetTexture(filename), lodError);
+}
+
+/* Creates a mesh with an already resolved texture and returns its index. With nLods above one, simplified levels
+ * are added from the optimized vertices, which all levels share.
+ */
+GLuint UAddTexturedMesh(const GLfloat* verts, GLuint nVertices, const GLuint* indices, GLuint nIndices, GLuint textureId, float lodError, GLuint nLods)
+{
+    GLMesh mesh;
+    mesh.textureId = textureId;
+    mesh.nLods = 0;
+
+    UComputeBounds(verts, nVertices, mesh);
+    GLuint meshIndex = gMeshVector.size();
+
+    // Triangle lists without indices reference each vertex once in order
+    vector<GLuint> levelIndices;
+    if (indices)
+        levelIndices.assign(indices, indices + nIndices);
+    else
+    {
+        levelIndices.resize(nVertices);
+        for (GLuint i = 0; i < nVertices; i++)
+            levelIndices[i] = i;
+    }
+
+    // The optimizer may weld or drop vertices, so the mesh can come out with fewer than it went in with
+    vector<GLfloat> optimizedVertices;
+    if (gOptimizeMeshes)
+    {
+        optimizedVertices.assign(verts, verts + nVertices * FLOATS_PER_VERTEX);
+        VertexCacheStats before, after;
+        OptimizeMesh(optimizedVertices, levelIndices, before, after);
+        if (gMeshStats)
+            UPrintCacheStats("Mesh " + to_string(meshIndex) + " LOD 0", before, after);
+
+        verts = optimizedVertices.data();
+        nVertices = optimizedVertices.size() / FLOATS_PER_VERTEX;
+    }
+
+    GLuint baseVertex = UStageVertices(mesh, verts, nVertices);
+    mesh.lods[mesh.nLods] = UStageLod(meshIndex, mesh, baseVertex, verts, nVertices, levelIndices.data(), levelIndices.size(), lodError);
+    mesh.nLods++;
+    gMeshVector.push_back(mesh);
+
+    UGenerateLods(meshIndex, verts, nVertices, levelIndices.data(), levelIndices.size(), nLods);
+    return meshIndex;
+}
+
+// Adds a coarser level of detail to an existing mesh, indexing the vertices of its most detailed level
+void UAddMeshLod(GLuint meshIndex, const GLfloat* verts, GLuint nVertices, const GLuint* indices, GLuint nIndices, float lodError)
+{
+    GLMesh& mesh = gMeshVector[meshIndex];
+    if (mesh.nLods == MAX_MESH_LODS)
+        return;
+
+    mesh.lods[mesh.nLods] = UStageLod(meshIndex, mesh, mesh.lods[0].baseVertex, verts, nVertices, indices, nIndices, lodError);
+    mesh.nLods++;
+}
+
+/* Adds simplified levels to a mesh until it has nLods, each keeping LOD_TRIANGLE_RATIOS of the full triangle count.
+ * Every level is simplified from the one before it, which is faster than starting over, so the errors add up.
+ * verts are the mesh's staged vertices, which the simplified levels index.
+ */
+void UGenerateLods(GLuint meshIndex, const GLfloat* verts, GLuint nVertices, const GLuint* indices, GLuint nIndices, GLuint nLods)
+{
+    vector<GLuint> previous(indices, indices + nIndices);
+    vector<GLuint> simplified;
+    float error = 0.0f;
+    for (GLuint lod = 1; lod < std::min(nLods, MAX_MESH_LODS); lod++)
+    {
+        size_t target = (size_t)(nIndices * LOD_TRIANGLE_RATIOS[lod - 1]) / 3 * 3;
+        error += SimplifyMesh(verts, nVertices, previous.data(), previous.size(), target, simplified);
+
+        // Nothing left to draw, or locked seams and borders keep the level from getting meaningfully coarser
+        if (simplified.empty() || simplified.size() > previous.size() * 9 / 10)
+            break;
+
+        UAddMeshLod(meshIndex, verts, nVertices, simplified.data(), simplified.size(), error);
+        previous.swap(simplified);
+    }
+}
+
+/* Returns the mesh whose bounds a ray enters first, or -1 when it hits none.
+ * distance receives how far along the (unit) direction the hit is.
+ */
+int UPickMesh(const glm::vec3& origin, const glm::vec3& direction, float& distance)
+{
+    glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    auto intersect = [&](uint32_t slot, float maxDistance)
+    {
+        return RayBoxEntry(origin, inverseDirection, gBvh.itemMin[slot], gBvh.itemMax[slot], maxDistance);
+    };
+
+    uint32_t slot;
+    if (!gBvh.raycast(origin, direction, FLT_MAX, intersect, slot, distance))
+        return -1;
+    return gDrawOrder[slot];
+}
+
+/* Picks the coarsest level whose error stays under gLodErrorPixels on screen.
+ * pixelsPerUnit is the screen size of one world unit at distance 1 (or at any distance when orthographic).
+ */
+GLuint USelectLod(const GLMesh& mesh, const glm::vec3& cameraPosition, float pixelsPerUnit, bool perspective)
+{
+    float distance = 1.0f;
+    if (perspective)
+    {
+        glm::vec3 closest = glm::clamp(cameraPosition, mesh.boundsMin, mesh.boundsMax);
+        distance = glm::length(cameraPosition - closest);
+        if (distance <= 0.0f)
+            return 0;
+    }
+
+    GLuint selected = 0;
+    for (GLuint lod = 1; lod < mesh.nLods; lod++)
+    {
+        if (mesh.lods[lod].error * pixelsPerUnit / distance > gLodErrorPixels)
+            break;
+        selected = lod;
+    }
+    return selected;
+}
+
+// Uploads the staged geometry and releases the staging buffers
+void UUploadGeometry()
+{
+    UUploadGeometry(gGeometry.vertices.data(), gGeometry.vertices.size(), gGeometry.indices.data(), gGeometry.indices.size());
+
+    // The GPU owns the data now
+    vector<unsigned char>().swap(gGeometry.vertices);
+    vector<GLuint>().swap(gGeometry.indices);
+}
+
+// Creates the shared buffers, vertex layout and draw batches for every mesh from vertex and index data in vertexStride layout
+void UUploadGeometry(const void* vertices, size_t vertexBytes, const GLuint* indices, size_t nIndices)
+{
+    const GLuint floatsPerVertex = 3;
+    const GLuint floatsPerNormal = 3;
+
+    // Placements start from the bounds the meshes have now
+    for (GLMesh& mesh : gMeshVector)
+    {
+        mesh.model = glm::mat4(1.0f);
+        mesh.restMin = mesh.boundsMin;
+        mesh.restMax = mesh.boundsMax;
+        mesh.restSphereCenter = mesh.sphereCenter;
+        mesh.restSphereRadius = mesh.sphereRadius;
+    }
+
+    glCreateVertexArrays(1, &gGeometry.vao);
+
+    glCreateBuffers(1, &gGeometry.vbo);
+    glNamedBufferData(gGeometry.vbo, vertexBytes, vertices, GL_STATIC_DRAW);
+
+    glCreateBuffers(1, &gGeometry.ebo);
+    glNamedBufferData(gGeometry.ebo, nIndices * sizeof(GLuint), indices, GL_STATIC_DRAW);
+    glVertexArrayElementBuffer(gGeometry.vao, gGeometry.ebo);
+
+    // Separate the vertex format from the buffer so every mesh shares the one binding point
+    if (gPackedVertices)
+    {
+        glVertexArrayAttribFormat(gGeometry.vao, 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedVertex, position));
+        glVertexArrayAttribFormat(gGeometry.vao, 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedVertex, normal));
+        glVertexArrayAttribFormat(gGeometry.vao, 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, uv));
+    }
+    else
+    {
+        glVertexArrayAttribFormat(gGeometry.vao, 0, floatsPerVertex, GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayAttribFormat(gGeometry.vao, 1, floatsPerNormal, GL_FLOAT, GL_FALSE, sizeof(float) * floatsPerVertex);
+        glVertexArrayAttribFormat(gGeometry.vao, 2, 2, GL_FLOAT, GL_FALSE, sizeof(float) * (floatsPerVertex + floatsPerNormal));
+    }
+    for (GLuint attrib = 0; attrib < 3; attrib++)
+    {
+        glVertexArrayAttribBinding(gGeometry.vao, attrib, 0);
+        glEnableVertexArrayAttrib(gGeometry.vao, attrib);
+    }
+    glVertexArrayVertexBuffer(gGeometry.vao, 0, gGeometry.vbo, 0, gGeometry.vertexStride);
+
+    // Quantization bounds advance once per instance, so the draw's base instance (the mesh index) selects them
+    if (gPackedVertices)
+    {
+        vector<GLfloat> meshBounds;
+        meshBounds.reserve(gMeshVector.size() * 6);
+        for (const GLMesh& mesh : gMeshVector)
+        {
+            glm::vec3 boundsExtent = mesh.boundsMax - mesh.boundsMin;
+            const GLfloat bounds[] = { mesh.boundsMin.x, mesh.boundsMin.y, mesh.boundsMin.z, boundsExtent.x, boundsExtent.y, boundsExtent.z };
+            meshBounds.insert(meshBounds.end(), bounds, bounds + 6);
+        }
+
+        glCreateBuffers(1, &gGeometry.boundsBuffer);
+        glNamedBufferData(gGeometry.boundsBuffer, meshBounds.size() * sizeof(GLfloat), meshBounds.data(), GL_STATIC_DRAW);
+    }
+
+    // Each mesh's transform index advances once per instance like the bounds, the draw's base instance selects it
+    vector<GLuint> objectIndices(gMeshVector.size());
+    for (GLuint i = 0; i < objectIndices.size(); i++)
+        objectIndices[i] = i;
+    glCreateBuffers(1, &gGeometry.objectIndexBuffer);
+    glNamedBufferData(gGeometry.objectIndexBuffer, objectIndices.size() * sizeof(GLuint), objectIndices.data(), GL_STATIC_DRAW);
+
+    // The depth pre-pass fetches positions alone, so they get a stream of their own instead of a stride through
+    // the interleaved vertices
+    size_t nVertices = vertexBytes / gGeometry.vertexStride;
+    size_t positionSize = gPackedVertices ? sizeof(PackedVertex::position) : sizeof(float) * floatsPerVertex;
+    vector<unsigned char> positions(nVertices * positionSize);
+    for (size_t v = 0; v < nVertices; v++)
+        memcpy(&positions[v * positionSize], (const unsigned char*)vertices + v * gGeometry.vertexStride + (gPackedVertices ? offsetof(PackedVertex, position) : 0), positionSize);
+
+    glCreateVertexArrays(1, &gGeometry.depthVao);
+    glCreateBuffers(1, &gGeometry.positionBuffer);
+    glNamedBufferData(gGeometry.positionBuffer, positions.size(), positions.data(), GL_STATIC_DRAW);
+    glVertexArrayElementBuffer(gGeometry.depthVao, gGeometry.ebo);
+    if (gPackedVertices)
+        glVertexArrayAttribFormat(gGeometry.depthVao, 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, 0);
+    else
+        glVertexArrayAttribFormat(gGeometry.depthVao, 0, floatsPerVertex, GL_FLOAT, GL_FALSE, 0);
+    glVertexArrayAttribBinding(gGeometry.depthVao, 0, 0);
+    glEnableVertexArrayAttrib(gGeometry.depthVao, 0);
+    glVertexArrayVertexBuffer(gGeometry.depthVao, 0, gGeometry.positionBuffer, 0, (GLsizei)positionSize);
+
+    // Both vertex arrays take the bounds and transform indices through the same bindings
+    for (GLuint vao : { gGeometry.vao, gGeometry.depthVao })
+    {
+        if (gPackedVertices)
+        {
+            glVertexArrayAttribFormat(vao, 3, 3, GL_FLOAT, GL_FALSE, 0);
+            glVertexArrayAttribFormat(vao, 4, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3);
+            for (GLuint attrib = 3; attrib < 5; attrib++)
+            {
+                glVertexArrayAttribBinding(vao, attrib, 1);
+                glEnableVertexArrayAttrib(vao, attrib);
+            }
+            glVertexArrayVertexBuffer(vao, 1, gGeometry.boundsBuffer, 0, sizeof(float) * 6);
+            glVertexArrayBindingDivisor(vao, 1, 1);
+        }
+        glVertexArrayAttribIFormat(vao, 5, 1, GL_UNSIGNED_INT, 0);
+        glVertexArrayAttribBinding(vao, 5, 2);
+        glEnableVertexArrayAttrib(vao, 5);
+        glVertexArrayVertexBuffer(vao, 2, gGeometry.objectIndexBuffer, 0, sizeof(GLuint));
+        glVertexArrayBindingDivisor(vao, 2, 1);
+    }
+
+    glCreateBuffers(1, &gGeometry.objectBuffer);
+    glNamedBufferData(gGeometry.objectBuffer, gMeshVector.size() * sizeof(ObjectTransform), nullptr, GL_DYNAMIC_DRAW);
+    UBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_STORAGE_BINDING, gGeometry.objectBuffer);
+    UUploadObjects();
+
+    // One command per mesh, grouped by shader variant and then by texture, so each texture costs a single
+    // multi-draw and each variant a single program switch
+    vector<unsigned int> variants(gMeshVector.size());
+    for (size_t i = 0; i < gMeshVector.size(); i++)
+        variants[i] = UMeshVariant(gMeshVector[i].textureId);
+    gDrawOrder.resize(gMeshVector.size());
+    for (GLuint i = 0; i < gDrawOrder.size(); i++)
+        gDrawOrder[i] = i;
+    stable_sort(gDrawOrder.begin(), gDrawOrder.end(), [&](GLuint a, GLuint b)
+    {
+        if (variants[a] != variants[b])
+            return variants[a] < variants[b];
+        return gMeshVector[a].textureId < gMeshVector[b].textureId;
+    });
+
+    gDrawBatches.clear();
+    for (GLuint i = 0; i < gDrawOrder.size(); i++)
+    {
+        const GLMesh& mesh = gMeshVector[gDrawOrder[i]];
+        unsigned int variant = variants[gDrawOrder[i]];
+        if (gDrawBatches.empty() || gDrawBatches.back().variant != variant || gDrawBatches.back().textureId != mesh.textureId)
+            gDrawBatches.push_back({ variant, mesh.textureId, i, 0, 0 });
+        gDrawBatches.back().nCommands++;
+    }
+
+    gCullBounds.resize(gDrawOrder.size());
+    for (GLuint i = 0; i < gDrawOrder.size(); i++)
+    {
+        const GLMesh& mesh = gMeshVector[gDrawOrder[i]];
+        gCullBounds.set(i, mesh.boundsMin, mesh.boundsMax, mesh.sphereCenter, mesh.sphereRadius);
+    }
+    gVisible.resize(gDrawOrder.size());
+    gCullCache.valid = false;
+
+    gMeshSlots.resize(gDrawOrder.size());
+    for (GLuint i = 0; i < gDrawOrder.size(); i++)
+        gMeshSlots[gDrawOrder[i]] = i;
+
+    gOccluderSlots.clear();
+    for (GLuint i = 0; i < gDrawOrder.size(); i++)
+    {
+        if (gMeshVector[gDrawOrder[i]].occluder)
+            gOccluderSlots.push_back(i);
+    }
+
+    vector<glm::vec3> slotMin(gDrawOrder.size()), slotMax(gDrawOrder.size());
+    for (GLuint i = 0; i < gDrawOrder.size(); i++)
+    {
+        slotMin[i] = gMeshVector[gDrawOrder[i]].boundsMin;
+        slotMax[i] = gMeshVector[gDrawOrder[i]].boundsMax;
+    }
+    gBvh.build(slotMin.data(), slotMax.data(), gDrawOrder.size());
+
+    // The GPU culling rewrites its commands every frame with the level of detail each mesh needs, the CPU culling
+    // writes them to the frame ring instead
+    glCreateBuffers(1, &gGeometry.drawBuffer);
+    glNamedBufferData(gGeometry.drawBuffer, gDrawOrder.size() * sizeof(DrawCommand), nullptr, GL_DYNAMIC_DRAW);
+}
+
+// Works out every mesh's normal matrix and sends all the transforms to the Objects buffer
+void UUploadObjects()
+{
+    vector<glm::mat4> models(gMeshVector.size());
+    for (size_t i = 0; i < gMeshVector.size(); i++)
+        models[i] = gMeshVector[i].model;
+    vector<ObjectTransform> objects(gMeshVector.size());
+    ComputeObjectTransforms(models.data(), objects.data(), objects.size());
+
+    glNamedBufferSubData(gGeometry.objectBuffer, 0, objects.size() * sizeof(ObjectTransform), objects.data());
+    gObjectsDirty = false;
+}
+
+/* Places an uploaded mesh anew. Its bounds are the box around its uploaded bounds under model, always worked out from
+ * those so repeated rotations do not keep growing them. Culling, picking and the GPU slots see them at once; the
+ * transforms and the hierarchy are brought up to date once at the next frame however many meshes moved.
+ */
+void USetMeshTransform(GLuint meshIndex, const glm::mat4& model)
+{
+    GLMesh& mesh = gMeshVector[meshIndex];
+    mesh.model = model;
+
+    glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec3 p((corner & 1) ? mesh.restMax.x : mesh.restMin.x, (corner & 2) ? mesh.restMax.y : mesh.restMin.y,
+                    (corner & 4) ? mesh.restMax.z : mesh.restMin.z);
+        p = glm::vec3(model * glm::vec4(p, 1.0f));
+        boundsMin = glm::min(boundsMin, p);
+        boundsMax = glm::max(boundsMax, p);
+    }
+    float scale = max(glm::length(glm::vec3(model[0])), max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    mesh.boundsMin = boundsMin;
+    mesh.boundsMax = boundsMax;
+    mesh.sphereCenter = glm::vec3(model * glm::vec4(mesh.restSphereCenter, 1.0f));
+    mesh.sphereRadius = mesh.restSphereRadius * scale;
+
+    GLuint slot = gMeshSlots[meshIndex];
+    gCullBounds.set(slot, mesh.boundsMin, mesh.boundsMax, mesh.sphereCenter, mesh.sphereRadius);
+    gBvh.update(slot, mesh.boundsMin, mesh.boundsMax);
+    CullCacheMarkMoved(gCullCache, slot);
+    if (gGpuCulling)
+    {
+        GpuCullSlot bounds;
+        bounds.sphere = glm::vec4(mesh.sphereCenter, mesh.sphereRadius);
+        bounds.boundsMin = glm::vec4(mesh.boundsMin, 0.0f);
+        bounds.boundsMax = glm::vec4(mesh.boundsMax, 0.0f);
+        glNamedBufferSubData(gGpuCull.slotBuffer, slot * sizeof(GpuCullSlot), offsetof(GpuCullSlot, lods), &bounds);
+    }
+    gObjectsDirty = true;
+}
+
+/* Submits a vertex and fragment program. Compiling and linking are only started here, UFinishPrograms checks them,
+ * so the driver can work on every submitted program at once.
+ */
+bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint &programId)
+{
+    // Both stages share the FrameData block, the vertex stage also reads the Objects buffer
+    string vertex = InsertShaderPrelude(vtxShaderSource, string(frameDataShaderSource) + objectDataShaderSource);
+    string fragment = InsertShaderPrelude(fragShaderSource, frameDataShaderSource);
+    const char* sources[] = { vertex.c_str(), fragment.c_str() };
+    const GLenum stages[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    return UBeginProgram(sources, stages, 2, programId);
+}
+
+// Submits a compute shader program, checked by UFinishPrograms like the others
+bool UCreateComputeProgram(const char* computeShaderSource, GLuint& programId)
+{
+    const GLenum stage = GL_COMPUTE_SHADER;
+    return UBeginProgram(&computeShaderSource, &stage, 1, programId);
+}
+
+// The cheapest mesh shader variant that draws a material correctly
+unsigned int UMaterialVariant(bool textured, SceneLighting lighting)
+{
+    unsigned int variant = 0;
+    if (textured)
+        variant |= SHADER_TEXTURED;
+    if (lighting != SCENE_LIGHTING_UNLIT)
+        variant |= SHADER_LIT;
+    if (lighting == SCENE_LIGHTING_PHONG)
+        variant |= SHADER_SPECULAR;
+    return NormalizeShaderVariant(variant);
+}
+
+// The variant of the surfaces using a texture, 0 being none
+unsigned int UMeshVariant(GLuint textureId)
+{
+    auto lighting = gTextureLighting.find(textureId);
+    return UMaterialVariant(textureId != 0, lighting == gTextureLighting.end() ? SCENE_LIGHTING_PHONG : lighting->second);
+}
+
+// Submits a variant's program unless it already has one, it is checked by UFinishPrograms like the others
+bool USubmitVariantProgram(unsigned int variant)
+{
+    if (gVariantPrograms[variant])
+        return true;
+    string fragment = InjectShaderDefines(meshFragmentShaderSource, variant);
+    return UCreateShaderProgram(gPackedVertices ? meshPackedVertexShaderSource : meshVertexShaderSource, fragment.c_str(), gVariantPrograms[variant]);
+}
+
+/* The program of a mesh shader variant. Variants the scene uses are submitted at startup, any other one is compiled
+ * the first time it is drawn. A variant that fails to build falls back to the full mesh program.
+ */
+GLuint UVariantProgram(unsigned int variant)
+{
+    GLuint& program = gVariantPrograms[variant];
+    if (program)
+        return program;
+
+    if (!USubmitVariantProgram(variant) || !UFinishPrograms())
+    {
+        glDeleteProgram(program);
+        program = gMeshProgramId;
+        return program;
+    }
+    glProgramUniform1i(program, UUniformLocation(program, "uTexture"), 0); // Set texture unit
+    return program;
+}
+
+/* Loads a program from the binary cache, or compiles and links it from source without asking how either went.
+ * Any status query would wait for the compile, so the checks are all left to UFinishPrograms.
+ */
+bool UBeginProgram(const char* const* sources, const GLenum* stages, GLsizei nShaders, GLuint& programId)
+{
+    double start = glfwGetTime();
+    uint64_t key = UProgramKey(sources, nShaders);
+    if (ULoadProgramBinary(key, programId))
+    {
+        UReflectUniforms(programId);
+        gProgramCacheStats.seconds += glfwGetTime() - start;
+        return true;
+    }
+
+    programId = glCreateProgram();
+    if (!programId)
+    {
+        cout << "Failed to create a shader program" << endl;
+        return false;
+    }
+    if (gProgramCacheDir)
+        glProgramParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    PendingProgram pending = {};
+    pending.program = programId;
+    pending.nShaders = nShaders;
+    pending.key = key;
+    for (GLsizei i = 0; i < nShaders; i++)
+    {
+        pending.stages[i] = stages[i];
+        pending.shaders[i] = glCreateShader(stages[i]);
+        glShaderSource(pending.shaders[i], 1, &sources[i], NULL);
+        glCompileShader(pending.shaders[i]);
+        glAttachShader(programId, pending.shaders[i]);
+    }
+    glLinkProgram(programId);
+    gPendingPrograms.push_back(pending);
+
+    gProgramCacheStats.seconds += glfwGetTime() - start;
+    return true;
+}
+
+/* Waits for every submitted program and reports those that failed. When the driver compiles in parallel, programs
+ * are taken as they complete, so the binary saves and reflection of finished ones overlap the ones still compiling.
+ */
+bool UFinishPrograms()
+{
+    double start = glfwGetTime();
+    bool success = true;
+    while (!gPendingPrograms.empty())
+    {
+        size_t next = 0; // The oldest, waiting on it, when none is known to be done
+        for (size_t i = 0; gParallelShaderCompile && i < gPendingPrograms.size(); i++)
+        {
+            GLint completed = GL_FALSE;
+            glGetProgramiv(gPendingPrograms[i].program, GL_COMPLETION_STATUS_KHR, &completed);
+            if (completed)
+            {
+                next = i;
+                break;
+            }
+        }
+        PendingProgram pending = gPendingPrograms[next];
+        gPendingPrograms.erase(gPendingPrograms.begin() + next);
+        success = UFinishProgram(pending) && success;
+    }
+    gProgramCacheStats.seconds += glfwGetTime() - start;
+    return success;
+}
+
+// Checks one submitted program, printing the compile logs of its stages when it failed to link
+bool UFinishProgram(const PendingProgram& pending)
+{
+    // Compilation and linkage error reporting
+    int success = 0;
+    char infoLog[512];
+
+    glGetProgramiv(pending.program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        for (GLsizei i = 0; i < pending.nShaders; i++)
+        {
+            int compiled = 0;
+            glGetShaderiv(pending.shaders[i], GL_COMPILE_STATUS, &compiled);
+            if (compiled)
+                continue;
+            glGetShaderInfoLog(pending.shaders[i], sizeof(infoLog), NULL, infoLog);
+            const char* stage = pending.stages[i] == GL_VERTEX_SHADER ? "VERTEX" : pending.stages[i] == GL_FRAGMENT_SHADER ? "FRAGMENT" : "COMPUTE";
+            std::cout << "ERROR::SHADER::" << stage << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+        }
+        glGetProgramInfoLog(pending.program, sizeof(infoLog), NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    }
+
+    // The linked program keeps what it needs, the shaders are freed along with it
+    for (GLsizei i = 0; i < pending.nShaders; i++)
+    {
+        glDetachShader(pending.program, pending.shaders[i]);
+        glDeleteShader(pending.shaders[i]);
+    }
+    if (!success)
+        return false;
+
+    USaveProgramBinary(pending.key, pending.program);
+    UReflectUniforms(pending.program);
+    gProgramCacheStats.compiled++;
+    return true;
+}
+
+// Key of a program in the binary cache: its sources in stage order, then the driver that would link them
+uint64_t UProgramKey(const char* const* sources, int nSources)
+{
+    uint64_t key = ProgramCacheHash("", HashBytes(&nSources, sizeof(nSources)));
+    for (int i = 0; i < nSources; i++)
+        key = ProgramCacheHash(sources[i], key);
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+        key = ProgramCacheHash((const char*)glGetString(name), key);
+    return key;
+}
+
+/* Creates a program from its cached binary. A missing entry returns false quietly, one the driver rejects, say
+ * after an update that kept the version string, is deleted so the compile that follows replaces it.
+ */
+bool ULoadProgramBinary(uint64_t key, GLuint& programId)
+{
+    if (!gProgramCacheDir)
+        return false;
+
+    string path = ProgramCachePath(gProgramCacheDir, key);
+    MappedFile file;
+    if (!file.open(path.c_str()))
+        return false;
+    if (!ProgramCacheValid(file.data(), file.size(), key))
+    {
+        file.close();
+        remove(path.c_str());
+        gProgramCacheStats.rejected++;
+        return false;
+    }
+
+    ProgramCacheHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    programId = glCreateProgram();
+    glProgramBinary(programId, header.format, file.data() + sizeof(header), (GLsizei)header.length);
+    GLint success = 0;
+    glGetProgramiv(programId, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glDeleteProgram(programId);
+        file.close();
+        remove(path.c_str());
+        gProgramCacheStats.rejected++;
+        return false;
+    }
+
+    gProgramCacheStats.loaded++;
+    return true;
+}
+
+// Writes a freshly linked program to the cache. Failing to is not an error, the next run compiles again.
+void USaveProgramBinary(uint64_t key, GLuint programId)
+{
+    if (!gProgramCacheDir)
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    vector<unsigned char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(programId, length, &length, &format, binary.data());
+
+    error_code error;
+    filesystem::create_directories(gProgramCacheDir, error);
+    string path = ProgramCachePath(gProgramCacheDir, key);
+    string tempPath = path + ".tmp";
+    ofstream out(tempPath, ios::binary | ios::trunc);
+    if (!out)
+    {
+        cout << "Failed to write " << tempPath << endl;
+        return;
+    }
+
+    ProgramCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+    header.version = PROGRAM_CACHE_VERSION;
+    header.format = format;
+    header.key = key;
+    header.length = (uint64_t)length;
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)binary.data(), length);
+    out.close();
+    if (!out)
+    {
+        cout << "Failed to write " << tempPath << endl;
+        remove(tempPath.c_str());
+        return;
+    }
+
+    // Renamed into place so a run that stops halfway never leaves a truncated entry under the real name
+    remove(path.c_str());
+    if (rename(tempPath.c_str(), path.c_str()) != 0)
+        remove(tempPath.c_str());
+}
+
+// Caches the location of every active uniform of a freshly linked program, arrays under both name and name[0]
+void UReflectUniforms(GLuint programId)
+{
+    unordered_map<string, GLint>& locations = gUniformLocations[programId];
+    locations.clear();
+
+    GLint nUniforms = 0, maxLength = 0;
+    glGetProgramiv(programId, GL_ACTIVE_UNIFORMS, &nUniforms);
+    glGetProgramiv(programId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    vector<GLchar> name(maxLength + 1);
+    for (GLint i = 0; i < nUniforms; i++)
+    {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(programId, (GLuint)i, (GLsizei)name.size(), nullptr, &size, &type, name.data());
+        GLint location = glGetUniformLocation(programId, name.data());
+        if (location < 0)
+            continue; // Block members live in their buffer
+
+        string uniformName(name.data());
+        locations[uniformName] = location;
+        size_t bracket = uniformName.find('[');
+        if (bracket != string::npos)
+            locations[uniformName.substr(0, bracket)] = location;
+    }
+}
+
+// Cached location of a uniform, -1 like glGetUniformLocation when the program has no such active uniform
+GLint UUniformLocation(GLuint programId, const char* name)
+{
+    auto program = gUniformLocations.find(programId);
+    if (program == gUniformLocations.end())
+        return -1;
+    auto location = program->second.find(name);
+    return location == program->second.end() ? -1 : location->second;
+}
+
+// Creates and maps the frame ring, at least regionSize bytes per frame plus room to align them
+bool UCreateFrameRing(GLsizeiptr regionSize)
+{
+    GLint uniformAlignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    gFrameRing.uniformAlignment = uniformAlignment;
+    gFrameRing.regionSize = (regionSize + 2 * uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+    gFrameRing.region = 0;
+    gFrameRing.used = 0;
+    gFrameRing.overflowed = false;
+    for (GLsync& fence : gFrameRing.fences)
+        fence = 0;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &gFrameRing.buffer);
+    glNamedBufferStorage(gFrameRing.buffer, gFrameRing.regionSize * FRAME_RING_REGIONS, nullptr, flags);
+    gFrameRing.mapped = (unsigned char*)glMapNamedBufferRange(gFrameRing.buffer, 0, gFrameRing.regionSize * FRAME_RING_REGIONS, flags);
+    if (!gFrameRing.mapped)
+    {
+        cout << "Failed to map the frame ring buffer" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Moves on to the frame's region, waiting for the GPU to finish the frame that used it last
+void UBeginFrameRing()
+{
+    GLsync& fence = gFrameRing.fences[gFrameRing.region];
+    if (fence)
+    {
+        GLenum status;
+        do
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // Nanoseconds
+        while (status == GL_TIMEOUT_EXPIRED);
+        glDeleteSync(fence);
+        fence = 0;
+    }
+    gFrameRing.used = 0;
+}
+
+/* Bump allocates size bytes of the frame's region, returning where to write them and their offset in the ring's buffer.
+ * Returns nullptr when the region is full, which callers must handle by skipping their upload; regions are sized for
+ * the frame's known uploads plus FRAME_RING_SPARE.
+ */
+void* UFrameRingAllocate(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset)
+{
+    GLsizeiptr start = (gFrameRing.used + alignment - 1) / alignment * alignment;
+    if (start + size > gFrameRing.regionSize)
+    {
+        if (!gFrameRing.overflowed)
+            cout << "Frame ring region of " << gFrameRing.regionSize << " bytes cannot fit " << size << " more, skipping the upload" << endl;
+        gFrameRing.overflowed = true;
+        return nullptr;
+    }
+    gFrameRing.used = start + size;
+    offset = gFrameRing.region * gFrameRing.regionSize + start;
+    return gFrameRing.mapped + offset;
+}
+
+// Fences the frame's region after every command that reads it and moves to the next one
+void UEndFrameRing()
+{
+    gFrameRing.fences[gFrameRing.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    gFrameRing.region = (gFrameRing.region + 1) % FRAME_RING_REGIONS;
+}
+
+// Unmaps and destroys the frame ring
+void UDestroyFrameRing()
+{
+    for (GLsync& fence : gFrameRing.fences)
+    {
+        if (fence)
+            glDeleteSync(fence);
+        fence = 0;
+    }
+    glUnmapNamedBuffer(gFrameRing.buffer);
+    glDeleteBuffers(1, &gFrameRing.buffer);
+}
+
+/* Tracked state setters. Each compares against gState and only reaches GL when the value changes, counting the
+ * calls it saved. Resources are created through direct state access, so nothing else moves these bindings.
+ */
+int UStateBufferTarget(GLenum target)
+{
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER: return 0;
+    case GL_DRAW_INDIRECT_BUFFER: return 1;
+    case GL_PARAMETER_BUFFER_ARB: return 2;
+    case GL_SHADER_STORAGE_BUFFER: return 3;
+    case GL_UNIFORM_BUFFER: return 4;
+    default: return -1;
+    }
+}
+
+bool UStateChanged(bool changed)
+{
+    if (changed)
+        gState.issued++;
+    else
+        gState.skipped++;
+    return changed;
+}
+
+void UUseProgram(GLuint program)
+{
+    if (UStateChanged(gState.program != program))
+    {
+        gState.program = program;
+        glUseProgram(program);
+    }
+}
+
+void UBindVertexArray(GLuint vertexArray)
+{
+    if (UStateChanged(gState.vertexArray != vertexArray))
+    {
+        gState.vertexArray = vertexArray;
+        glBindVertexArray(vertexArray);
+    }
+}
+
+// Binds a 2D texture to a unit, selecting the unit only when the binding changes
+void UBindTexture(GLuint unit, GLuint texture)
+{
+    if (unit >= STATE_TEXTURE_UNITS)
+    {
+        gState.issued++;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        gState.activeTexture = unit;
+        return;
+    }
+    if (!UStateChanged(gState.textures[unit] != texture))
+        return;
+    if (gState.activeTexture != unit)
+    {
+        gState.activeTexture = unit;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    gState.textures[unit] = texture;
+    glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void UBindBuffer(GLenum target, GLuint buffer)
+{
+    int slot = UStateBufferTarget(target);
+    if (slot < 0 || UStateChanged(gState.buffers[slot] != buffer))
+    {
+        if (slot >= 0)
+            gState.buffers[slot] = buffer;
+        glBindBuffer(target, buffer);
+    }
+}
+
+// Indexed bindings also set the target's generic binding, which the cache follows
+void UBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    int slot = UStateBufferTarget(target);
+    if (slot < 0 || index >= STATE_BUFFER_INDICES)
+    {
+        glBindBufferRange(target, index, buffer, offset, size);
+        return;
+    }
+    GLStateRange& range = gState.ranges[slot][index];
+    if (UStateChanged(range.buffer != buffer || range.offset != offset || range.size != size || gState.buffers[slot] != buffer))
+    {
+        range = { buffer, offset, size };
+        gState.buffers[slot] = buffer;
+        if (size == 0)
+            glBindBufferBase(target, index, buffer);
+        else
+            glBindBufferRange(target, index, buffer, offset, size);
+    }
+}
+
+void UBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    UBindBufferRange(target, index, buffer, 0, 0);
+}
+
+void UBindFramebuffer(GLuint framebuffer)
+{
+    if (UStateChanged(gState.framebuffer != framebuffer))
+    {
+        gState.framebuffer = framebuffer;
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+}
+
+void UEnable(GLenum capability, bool enabled)
+{
+    auto known = gState.enables.find(capability);
+    if (UStateChanged(known == gState.enables.end() || known->second != enabled))
+    {
+        gState.enables[capability] = enabled;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+}
+
+void UClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+    const GLfloat color[4] = { red, green, blue, alpha };
+    if (UStateChanged(!equal(color, color + 4, gState.clearColor)))
+    {
+        copy(color, color + 4, gState.clearColor);
+        glClearColor(red, green, blue, alpha);
+    }
+}
+
+void UDepthFunc(GLenum function)
+{
+    if (UStateChanged(gState.depthFunc != function))
+    {
+        gState.depthFunc = function;
+        glDepthFunc(function);
+    }
+}
+
+void UDepthMask(bool write)
+{
+    if (UStateChanged(gState.depthMask != write))
+    {
+        gState.depthMask = write;
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+}
+
+// All four channels together, the only way the frame uses it
+void UColorMask(bool write)
+{
+    if (UStateChanged(gState.colorMask != write))
+    {
+        gState.colorMask = write;
+        GLboolean mask = write ? GL_TRUE : GL_FALSE;
+        glColorMask(mask, mask, mask, mask);
+    }
+}
+
+void UViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    const GLint viewport[4] = { x, y, width, height };
+    if (UStateChanged(!equal(viewport, viewport + 4, gState.viewport)))
+    {
+        copy(viewport, viewport + 4, gState.viewport);
+        glViewport(x, y, width, height);
+    }
+}
+
+// Destroys all the meshes
+void UDestroyMesh()
+{
+    glDeleteVertexArrays(1, &gGeometry.vao);
+    glDeleteBuffers(1, &gGeometry.vbo);
+    glDeleteBuffers(1, &gGeometry.ebo);
+    glDeleteBuffers(1, &gGeometry.drawBuffer);
+    glDeleteBuffers(1, &gGeometry.boundsBuffer);
+    glDeleteVertexArrays(1, &gGeometry.depthVao);
+    glDeleteBuffers(1, &gGeometry.positionBuffer);
+    glDeleteBuffers(1, &gGeometry.objectBuffer);
+    glDeleteBuffers(1, &gGeometry.objectIndexBuffer);
+    gMeshVector.clear();
+    gDrawBatches.clear();
+}
+
+// Destroys all the shader programs
+void UDestroyShaderProgram()
+{
+    for (GLuint& program : gVariantPrograms)
+    {
+        if (program != gMeshProgramId)
+            glDeleteProgram(program);
+        program = 0;
+    }
+    glDeleteProgram(gMeshProgramId);
+    glDeleteProgram(gDepthProgramId);
+    UDestroyFrameRing();
+    gUniformLocations.clear();
+}
+
+// Destroys all the textures
+void UDestroyTexture()
+{
+    for (auto& texture : gTextureCache)
+    {
+        glDeleteTextures(1, &texture.second);
+    }
+    gTextureCache.clear();
+    gTextureLighting.clear();
+}
+
+// Initialize GLFW, GLEW, and create a window
+bool UInitialize(int argc, char* argv[], GLFWwindow** window)
+{
+    // GLFW: initialize and configure
+    // ------------------------------
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5); // Direct state access
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    // GLFW: window creation
+    // ---------------------
+    * window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE, NULL, NULL);
+    if (*window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+
+    glfwMakeContextCurrent(*window);
+    glfwSetFramebufferSizeCallback(*window, UResizeWindow);
+    glfwSetCursorPosCallback(*window, UMousePositionCallback);
+    glfwSetScrollCallback(*window, UMouseScrollCallback);
+
+    // tell GLFW to capture our mouse
+    glfwSetInputMode(*window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+    // GLEW: initialize
+    // ----------------
+    // Note: if using GLEW version 1.13 or earlier
+    glewExperimental = GL_TRUE;
+    GLenum GlewInitResult = glewInit();
+
+    if (GLEW_OK != GlewInitResult)
+    {
+        std::cerr << glewGetErrorString(GlewInitResult) << std::endl;
+        return false;
+    }
+
+    // Displays GPU OpenGL version
+    cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << endl;
+
+    // Shaders compile on the driver's threads, as many as it likes, when it can
+    if (GLEW_KHR_parallel_shader_compile)
+    {
+        glMaxShaderCompilerThreadsKHR(0xffffffff);
+        gParallelShaderCompile = true;
+    }
+    else if (GLEW_ARB_parallel_shader_compile)
+    {
+        glMaxShaderCompilerThreadsARB(0xffffffff);
+        gParallelShaderCompile = true;
+    }
+
+    // The state cache starts from the defaults, apart from the viewport which follows the window
+    int width, height;
+    glfwGetFramebufferSize(*window, &width, &height);
+    UViewport(0, 0, width, height);
+
+    return true;
+}
+
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+void UProcessInput(GLFWwindow* window)
+{
+    static const float cameraSpeed = 2.5f;
+
+    // Camera Movement
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        gCamera.ProcessKeyboard(FORWARD, gDeltaTime);
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        gCamera.ProcessKeyboard(BACKWARD, gDeltaTime);
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        gCamera.ProcessKeyboard(LEFT, gDeltaTime);
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        gCamera.ProcessKeyboard(RIGHT, gDeltaTime);
+    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
+        gCamera.ProcessKeyboard(DOWN, gDeltaTime);
+    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
+        gCamera.ProcessKeyboard(UP, gDeltaTime);
+
+    // Perspective
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
+    {
+        if (!gIsPPressed)
+        {
+            gIsPPressed = true;
+            gCamera.IsPerspective ^= 1; // Flip the boolean with bitwise
+        }
+    }
+    else
+        gIsPPressed = false;
+
+    // Depth pre-pass, to compare overdraw heavy views with and without it
+    if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS)
+    {
+        if (!gIsZPressed)
+        {
+            gIsZPressed = true;
+            gDepthPrepass = !gDepthPrepass;
+            cout << "Depth pre-pass " << (gDepthPrepass ? "on" : "off") << endl;
+        }
+    }
+    else
+        gIsZPressed = false;
+
+    // Pick the mesh under the crosshair, the cursor is captured so that is the screen center
+    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+    {
+        if (!gIsPickPressed)
+        {
+            gIsPickPressed = true;
+            float distance;
+            int picked = UPickMesh(gCamera.Position, gCamera.Front, distance);
+            if (picked >= 0)
+            {
+                gPickedMesh = picked;
+                cout << "Picked mesh " << picked << " at distance " << distance << endl;
+            }
+        }
+    }
+    else
+        gIsPickPressed = false;
+
+    // Spin the picked mesh about the vertical axis through its center
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && gPickedMesh >= 0)
+    {
+        const float spinSpeed = glm::radians(90.0f); // Per second
+        const GLMesh& mesh = gMeshVector[gPickedMesh];
+        glm::mat4 spin = glm::translate(mesh.sphereCenter) * glm::rotate(spinSpeed * gDeltaTime, glm::vec3(0.0f, 1.0f, 0.0f))
+            * glm::translate(-mesh.sphereCenter);
+        USetMeshTransform(gPickedMesh, spin * mesh.model);
+    }
+
+    // Quit
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+}
+
+// glfw: whenever the mouse moves, this callback is called
+void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos)
+{
+    if (gFirstMouse)
+    {
+        gLastX = xpos;
+        gLastY = ypos;
+        gFirstMouse = false;
+    }
+
+    float xoffset = xpos - gLastX;
+    float yoffset = gLastY - ypos; // reversed since y-coordinates go from bottom to top
+
+    gLastX = xpos;
+    gLastY = ypos;
+
+    gCamera.ProcessMouseMovement(xoffset, yoffset);
+}
+
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
+{
+    gCamera.ProcessMouseScroll(yoffset);
+}
+
+// Functioned called to render a frame
+void URender()
+{
+    gState.issued = 0;
+    gState.skipped = 0;
+
+    // Enable z-depth, writing it, so the clear reaches the depth buffer
+    UEnable(GL_DEPTH_TEST, true);
+    UDepthFunc(GL_LESS);
+    UDepthMask(true);
+    UColorMask(true);
+
+    // Clear the frame and z buffers
+    UClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // Creates a projection based off perspective
+    glm::mat4 projection;
+    if (gCamera.IsPerspective)
+        projection = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
+    else
+        projection = glm::ortho(-ORTHO_HALF_EXTENT, ORTHO_HALF_EXTENT, -ORTHO_HALF_EXTENT, ORTHO_HALF_EXTENT, -100.0f, 100.0f);
+
+    UBeginFrameRing();
+
+    // Camera, light and material constants are written once into the frame ring, every program reads them from the same block
+    FrameUniforms frame = {};
+    frame.view = gCamera.GetViewMatrix();
+    frame.projection = projection;
+    frame.lightColor = gLightColor;
+    frame.lightPos = gLightPosition;
+    frame.viewPosition = gCamera.Position;
+    frame.objectColor = gObjectColor;
+    frame.uvScale = gUVScale;
+    GLintptr frameOffset;
+    void* frameData = UFrameRingAllocate(sizeof(frame), gFrameRing.uniformAlignment, frameOffset);
+    if (!frameData)
+    {
+        // Nothing can be drawn without the uniforms, the cleared frame is shown as is
+        UEndFrameRing();
+        glfwSwapBuffers(gWindow);
+        return;
+    }
+    memcpy(frameData, &frame, sizeof(frame));
+    UBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, gFrameRing.buffer, frameOffset, sizeof(frame));
+
+    // Meshes moved since the last frame get their new transforms and a refitted hierarchy before anything is culled
+    if (gObjectsDirty)
+    {
+        gBvh.refit();
+        UUploadObjects();
+    }
+
+    // Cull and write this frame's draw commands, on the CPU or in a compute shader
+    glm::vec4 frustumPlanes[6];
+    const glm::mat4 view = gCamera.GetViewMatrix();
+    ExtractFrustumPlanes(projection * view, frustumPlanes);
+    float pixelsPerUnit = gCamera.IsPerspective
+        ? WINDOW_HEIGHT / (2.0f * tan(glm::radians(gCamera.Zoom) / 2.0f))
+        : WINDOW_HEIGHT / (2.0f * ORTHO_HALF_EXTENT);
+    if (gGpuCulling)
+        UCullOnGpu(view, projection, frustumPlanes, pixelsPerUnit);
+    else
+        UCullOnCpu(view, projection, frustumPlanes, pixelsPerUnit);
+
+    UBindBuffer(GL_DRAW_INDIRECT_BUFFER, gDrawCommandBuffer);
+    if (gGpuCulling && gGpuCull.drawCount)
+        UBindBuffer(GL_PARAMETER_BUFFER_ARB, gGpuCull.countBuffer);
+
+    // Depth of every batch first from positions alone, then shading only the fragments that won it
+    if (gDepthPrepass)
+    {
+        UUseProgram(gDepthProgramId);
+        UBindVertexArray(gGeometry.depthVao);
+        UColorMask(false);
+        UDrawBatches(false);
+        UColorMask(true);
+
+        UDepthFunc(GL_EQUAL);
+        UDepthMask(false);
+    }
+
+    UBindVertexArray(gGeometry.vao);
+    UDrawBatches(true);
+    UDepthFunc(GL_LESS);
+    UDepthMask(true);
+
+    // Heavy meshes last, so their box queries test against everything else. They stay out of the pre-pass, which
+    // would spend their vertex work on them even when their query finds them hidden.
+    if (gOcclusionQueries)
+        UDrawQueriedMeshes();
+    UEndFrameRing();
+    gFrameIndex++;
+
+    // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+    glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
+}
+
+// All meshes share one VAO, so each texture batch is a single multi-draw. The VAO and indirect buffers must be bound,
+// and the program too unless bindTextures, which also switches to each batch's shader variant.
+void UDrawBatches(bool bindTextures)
+{
+    bool drawCount = gGpuCulling && gGpuCull.drawCount;
+    for (GLuint b = 0; b < gDrawBatches.size(); b++)
+    {
+        const DrawBatch& batch = gDrawBatches[b];
+        if (batch.nVisible == 0)
+            continue;
+        if (bindTextures)
+        {
+            UUseProgram(UVariantProgram(batch.variant)); // Batches are sorted by variant, so this switches once per variant
+            UBindTexture(0, batch.textureId);
+        }
+        const void* commands = (void*)(gDrawCommandOffset + batch.firstCommand * sizeof(DrawCommand));
+        if (drawCount) // The culling shader counted the batch's commands, nVisible only caps them
+            glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, commands, b * sizeof(GLuint), batch.nVisible, 0);
+        else
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, commands, batch.nVisible, 0);
+    }
+}
+
+// Culls on this thread and writes the surviving draw commands to the frame ring, packed to the front of each batch
+void UCullOnCpu(const glm::mat4& view, const glm::mat4& projection, const glm::vec4 frustumPlanes[6], float pixelsPerUnit)
+{
+    // Only meshes touching the view frustum get a command. While the camera stays near the last full pass's, only meshes
+    // near its planes are tested again.
+    if (CullCacheUsable(gCullCache, view, projection))
+    {
+        gCullStats.visible = CullCacheUpdate(gCullCache, gCullBounds, frustumPlanes, gVisible.data());
+        gCullStats.tested = gCullCache.unsettled.size();
+    }
+    else
+    {
+        if (gDrawOrder.size() >= BVH_CULL_THRESHOLD)
+        {
+            fill(gVisible.begin(), gVisible.end(), 0);
+            gCullStats.visible = gBvh.cullFrustum(frustumPlanes, gVisible.data());
+        }
+        else
+            gCullStats.visible = CullFrustum(gCullBounds, frustumPlanes, gVisible.data());
+        CullCacheSettle(gCullCache, gCullBounds, frustumPlanes, view, projection, gCullStats.visible);
+        gCullStats.tested = gDrawOrder.size();
+    }
+    gCullStats.culled = gDrawOrder.size() - gCullStats.visible;
+
+    // Draw the occluders in view into the occlusion buffer, every other visible mesh is tested against it below
+    bool occlusionTest = gOcclusionCulling && !gOccluderSlots.empty();
+    gOcclusionStats = OcclusionStats();
+    if (occlusionTest)
+    {
+        gOcclusion.begin(projection * view);
+        for (GLuint slot : gOccluderSlots)
+        {
+            if (gVisible[slot])
+                gOcclusion.addBox(gBvh.itemMin[slot], gBvh.itemMax[slot]);
+        }
+        gOcclusion.rasterize();
+        gOcclusionStats.occluders = gOcclusion.occluderCount();
+        gOcclusionStats.triangles = gOcclusion.triangleCount();
+    }
+
+    // Pick each visible mesh's level of detail from its distance to the camera and queue it under its sort key. Every mesh
+    // shares the mesh program and the geometry VAO, so the key's material is the batch and its depth the nearest
+    // view distance of the bounding sphere.
+    gRenderQueue.clear();
+    gSlotCommands.resize(gDrawOrder.size());
+    for (GLuint b = 0; b < gDrawBatches.size(); b++)
+    {
+        const DrawBatch& batch = gDrawBatches[b];
+        for (GLuint i = batch.firstCommand; i < batch.firstCommand + batch.nCommands; i++)
+        {
+            if (!gVisible[i])
+                continue;
+
+            const GLMesh& mesh = gMeshVector[gDrawOrder[i]];
+            float windowArea;
+            if (occlusionTest)
+            {
+                gOcclusionStats.tested++;
+                if (!gOcclusion.visible(mesh.boundsMin, mesh.boundsMax, windowArea))
+                {
+                    gOcclusionStats.occluded++;
+                    gOcclusionStats.fragments += windowArea * WINDOW_WIDTH * WINDOW_HEIGHT;
+                    continue;
+                }
+            }
+
+            const GLMeshLod& lod = mesh.lods[USelectLod(mesh, gCamera.Position, pixelsPerUnit, gCamera.IsPerspective)];
+            gSlotCommands[i] = { lod.nIndices, 1, lod.firstIndex, lod.baseVertex, gDrawOrder[i] };
+            float viewDepth = -(view * glm::vec4(mesh.sphereCenter, 1.0f)).z - mesh.sphereRadius;
+            gRenderQueue.push(RenderKey(batch.variant, 0, b, gSortDraws ? RenderKeyDepth(viewDepth) : 0), i);
+        }
+    }
+    if (gSortDraws)
+        gRenderQueue.sort();
+
+    // Pack each batch's commands to its front in queue order, straight into the frame ring
+    DrawCommand* commands = (DrawCommand*)UFrameRingAllocate(gDrawOrder.size() * sizeof(DrawCommand), sizeof(GLuint), gDrawCommandOffset);
+    gDrawCommandBuffer = gFrameRing.buffer;
+    for (DrawBatch& batch : gDrawBatches)
+        batch.nVisible = 0;
+    gQueryDraws.clear();
+    if (!commands)
+        return; // No room for the commands, every batch is skipped this frame
+    for (size_t q = 0; q < gRenderQueue.size(); q++)
+    {
+        GLuint i = gRenderQueue.value(q);
+        DrawBatch& batch = gDrawBatches[RenderKeyMaterial(gRenderQueue.key(q))];
+        if (gOcclusionQueries && gQueryBoxes.slotMeshes[i] >= 0)
+            gQueryDraws.push_back({ i, gSlotCommands[i] }); // Drawn on its own, after the batches
+        else
+            commands[batch.firstCommand + batch.nVisible++] = gSlotCommands[i];
+    }
+}
+
+// Uploads every draw slot and sets up the occluder depth pyramid. The culling programs are created with the others.
+bool UCreateGpuCulling()
+{
+    // Without ARB_indirect_parameters every command is drawn and culled ones get no instances
+    gGpuCull.drawCount = GLEW_ARB_indirect_parameters;
+    if (!gGpuCull.drawCount)
+        cout << "INFO: ARB_indirect_parameters missing, GPU culled batches draw with zero instances" << endl;
+
+    vector<GpuCullSlot> slots(gDrawOrder.size());
+    for (GLuint b = 0; b < gDrawBatches.size(); b++)
+    {
+        const DrawBatch& batch = gDrawBatches[b];
+        for (GLuint i = batch.firstCommand; i < batch.firstCommand + batch.nCommands; i++)
+        {
+            const GLMesh& mesh = gMeshVector[gDrawOrder[i]];
+            GpuCullSlot& slot = slots[i];
+            slot.sphere = glm::vec4(mesh.sphereCenter, mesh.sphereRadius);
+            slot.boundsMin = glm::vec4(mesh.boundsMin, 0.0f);
+            slot.boundsMax = glm::vec4(mesh.boundsMax, 0.0f);
+            for (GLuint lod = 0; lod < mesh.nLods; lod++)
+            {
+                slot.lods[lod][0] = mesh.lods[lod].nIndices;
+                slot.lods[lod][1] = mesh.lods[lod].firstIndex;
+                slot.lods[lod][2] = mesh.lods[lod].baseVertex;
+                memcpy(&slot.lods[lod][3], &mesh.lods[lod].error, sizeof(float));
+            }
+            slot.nLods = mesh.nLods;
+            slot.meshIndex = gDrawOrder[i];
+            slot.batch = b;
+            slot.batchFirst = batch.firstCommand;
+        }
+    }
+    glCreateBuffers(1, &gGpuCull.slotBuffer);
+    glNamedBufferData(gGpuCull.slotBuffer, slots.size() * sizeof(GpuCullSlot), slots.data(), GL_STATIC_DRAW);
+
+    glCreateBuffers(1, &gGpuCull.countBuffer);
+    glNamedBufferData(gGpuCull.countBuffer, (gDrawBatches.size() + GPU_CULL_TOTALS) * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+
+    // The occluders are drawn at full detail whatever the camera sees, they are few
+    vector<DrawCommand> occluders;
+    gGpuCull.nOccluderTriangles = 0;
+    for (GLuint slot : gOccluderSlots)
+    {
+        const GLMeshLod& lod = gMeshVector[gDrawOrder[slot]].lods[0];
+        occluders.push_back({ lod.nIndices, 1, lod.firstIndex, lod.baseVertex, gDrawOrder[slot] });
+        gGpuCull.nOccluderTriangles += lod.nIndices / 3;
+    }
+    gGpuCull.nOccluders = (GLsizei)occluders.size();
+    glCreateBuffers(1, &gGpuCull.occluderBuffer);
+    glNamedBufferData(gGpuCull.occluderBuffer, occluders.size() * sizeof(DrawCommand), occluders.data(), GL_STATIC_DRAW);
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &gGpuCull.depthTexture);
+    glTextureStorage2D(gGpuCull.depthTexture, 1, GL_DEPTH_COMPONENT32F, HIZ_WIDTH, HIZ_HEIGHT);
+    glTextureParameteri(gGpuCull.depthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(gGpuCull.depthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &gGpuCull.hiZTexture);
+    glTextureStorage2D(gGpuCull.hiZTexture, HIZ_LEVELS, GL_R32F, HIZ_WIDTH, HIZ_HEIGHT);
+    glTextureParameteri(gGpuCull.hiZTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(gGpuCull.hiZTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(gGpuCull.hiZTexture, GL_TEXTURE_MAX_LEVEL, HIZ_LEVELS - 1);
+
+    glCreateFramebuffers(1, &gGpuCull.depthFramebuffer);
+    glNamedFramebufferTexture(gGpuCull.depthFramebuffer, GL_DEPTH_ATTACHMENT, gGpuCull.depthTexture, 0);
+    glNamedFramebufferDrawBuffer(gGpuCull.depthFramebuffer, GL_NONE);
+    glNamedFramebufferReadBuffer(gGpuCull.depthFramebuffer, GL_NONE);
+    if (glCheckNamedFramebufferStatus(gGpuCull.depthFramebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        cout << "Failed to create the GPU culling depth target" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+/* Culls every draw slot in a compute shader, which writes the commands and their per batch counts straight into the
+ * buffers the draws read. This frame's uniforms must be bound, the occluder pass draws with the depth pre-pass program.
+ */
+void UCullOnGpu(const glm::mat4& view, const glm::mat4& projection, const glm::vec4 frustumPlanes[6], float pixelsPerUnit)
+{
+    bool occlusion = gOcclusionCulling && gGpuCull.nOccluders > 0;
+    if (occlusion)
+    {
+        // Occluder depth only, then the pyramid of farthest depths over it
+        GLint viewport[4];
+        copy(gState.viewport, gState.viewport + 4, viewport);
+        UBindFramebuffer(gGpuCull.depthFramebuffer);
+        UViewport(0, 0, HIZ_WIDTH, HIZ_HEIGHT);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        UUseProgram(gDepthProgramId);
+        UBindVertexArray(gGeometry.depthVao);
+        UBindBuffer(GL_DRAW_INDIRECT_BUFFER, gGpuCull.occluderBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, gGpuCull.nOccluders, 0);
+        UBindFramebuffer(0);
+        UViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+        UUseProgram(gGpuCull.depthCopyProgram);
+        UBindTexture(1, gGpuCull.depthTexture);
+        glUniform1i(UUniformLocation(gGpuCull.depthCopyProgram, "depth"), 1);
+        glBindImageTexture(0, gGpuCull.hiZTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((HIZ_WIDTH + 7) / 8, (HIZ_HEIGHT + 7) / 8, 1);
+
+        UUseProgram(gGpuCull.depthReduceProgram);
+        for (GLint level = 1; level < HIZ_LEVELS; level++)
+        {
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            glBindImageTexture(0, gGpuCull.hiZTexture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+            glBindImageTexture(1, gGpuCull.hiZTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            glDispatchCompute(((HIZ_WIDTH >> level) + 7) / 8, ((HIZ_HEIGHT >> level) + 7) / 8, 1);
+        }
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+    GLuint program = gGpuCull.cullProgram;
+    UUseProgram(program);
+    glUniform1ui(UUniformLocation(program, "nSlots"), (GLuint)gDrawOrder.size());
+    glUniform1ui(UUniformLocation(program, "nBatches"), (GLuint)gDrawBatches.size());
+    glUniform4fv(UUniformLocation(program, "planes"), 6, glm::value_ptr(frustumPlanes[0]));
+    glUniformMatrix4fv(UUniformLocation(program, "viewProjection"), 1, GL_FALSE, glm::value_ptr(projection * view));
+    glUniform3f(UUniformLocation(program, "cameraPosition"), gCamera.Position.x, gCamera.Position.y, gCamera.Position.z);
+    glUniform1i(UUniformLocation(program, "perspective"), gCamera.IsPerspective);
+    glUniform1f(UUniformLocation(program, "pixelsPerUnit"), pixelsPerUnit);
+    glUniform1f(UUniformLocation(program, "lodErrorPixels"), gLodErrorPixels);
+    glUniform1i(UUniformLocation(program, "occlusion"), occlusion);
+    glUniform1i(UUniformLocation(program, "compact"), gGpuCull.drawCount);
+    glUniform2f(UUniformLocation(program, "windowSize"), (GLfloat)WINDOW_WIDTH, (GLfloat)WINDOW_HEIGHT);
+    glUniform1i(UUniformLocation(program, "hiZ"), 1);
+    UBindTexture(1, gGpuCull.hiZTexture);
+
+    glClearNamedBufferData(gGpuCull.countBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    UBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, gGpuCull.slotBuffer);
+    UBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, gGeometry.drawBuffer);
+    UBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, gGpuCull.countBuffer);
+    glDispatchCompute(((GLuint)gDrawOrder.size() + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    gDrawCommandBuffer = gGeometry.drawBuffer;
+    gDrawCommandOffset = 0;
+
+    // Each batch may draw all its commands, the counts written above say how many it does
+    for (DrawBatch& batch : gDrawBatches)
+        batch.nVisible = batch.nCommands;
+}
+
+// Reads the GPU culling totals back into the frame statistics. It waits for the GPU, so only --stats calls it.
+void UReadGpuCullStats()
+{
+    GLuint totals[GPU_CULL_TOTALS];
+    glGetNamedBufferSubData(gGpuCull.countBuffer, gDrawBatches.size() * sizeof(GLuint), sizeof(totals), totals);
+
+    gCullStats.visible = totals[GPU_CULL_VISIBLE];
+    gCullStats.culled = gDrawOrder.size() - totals[GPU_CULL_VISIBLE];
+    gCullStats.tested = gDrawOrder.size();
+    gOcclusionStats = OcclusionStats();
+    gOcclusionStats.occluders = gGpuCull.nOccluders;
+    gOcclusionStats.triangles = gGpuCull.nOccluderTriangles;
+    gOcclusionStats.tested = totals[GPU_CULL_VISIBLE];
+    gOcclusionStats.occluded = totals[GPU_CULL_OCCLUDED];
+    gOcclusionStats.fragments = (double)totals[GPU_CULL_FRAGMENTS] * GPU_CULL_FRAGMENT_UNIT;
+}
+
+// Destroys the GPU culling programs, buffers and depth pyramid
+void UDestroyGpuCulling()
+{
+    glDeleteProgram(gGpuCull.cullProgram);
+    glDeleteProgram(gGpuCull.depthCopyProgram);
+    glDeleteProgram(gGpuCull.depthReduceProgram);
+    glDeleteBuffers(1, &gGpuCull.slotBuffer);
+    glDeleteBuffers(1, &gGpuCull.countBuffer);
+    glDeleteBuffers(1, &gGpuCull.occluderBuffer);
+    glDeleteFramebuffers(1, &gGpuCull.depthFramebuffer);
+    glDeleteTextures(1, &gGpuCull.depthTexture);
+    glDeleteTextures(1, &gGpuCull.hiZTexture);
+}
+
+// Creates the query box cube, and the queries of every mesh heavy enough to be worth them. The box program is created with the others.
+bool UCreateQueryBoxes()
+{
+    gQueryBoxes.slotMeshes.assign(gDrawOrder.size(), -1);
+    for (GLuint i = 0; i < gDrawOrder.size(); i++)
+    {
+        if (gMeshVector[gDrawOrder[i]].lods[0].nIndices / 3 < QUERY_MIN_TRIANGLES)
+            continue;
+        MeshQueries mesh = {};
+        glGenQueries(QUERY_RING, mesh.queries);
+        mesh.latest = -1;
+        gQueryBoxes.slotMeshes[i] = (int)gQueryBoxes.meshes.size();
+        gQueryBoxes.meshes.push_back(mesh);
+    }
+
+    const GLfloat corners[] = { 0, 0, 0,  1, 0, 0,  0, 1, 0,  1, 1, 0,  0, 0, 1,  1, 0, 1,  0, 1, 1,  1, 1, 1 };
+    const GLuint faces[] = {
+        0, 2, 3,  0, 3, 1,  4, 5, 7,  4, 7, 6,  0, 1, 5,  0, 5, 4,
+        2, 6, 7,  2, 7, 3,  0, 4, 6,  0, 6, 2,  1, 3, 7,  1, 7, 5
+    };
+    glCreateVertexArrays(1, &gQueryBoxes.vao);
+    glCreateBuffers(1, &gQueryBoxes.vbo);
+    glNamedBufferData(gQueryBoxes.vbo, sizeof(corners), corners, GL_STATIC_DRAW);
+    glCreateBuffers(1, &gQueryBoxes.ebo);
+    glNamedBufferData(gQueryBoxes.ebo, sizeof(faces), faces, GL_STATIC_DRAW);
+    glVertexArrayElementBuffer(gQueryBoxes.vao, gQueryBoxes.ebo);
+    glVertexArrayAttribFormat(gQueryBoxes.vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
+    glVertexArrayAttribBinding(gQueryBoxes.vao, 0, 0);
+    glEnableVertexArrayAttrib(gQueryBoxes.vao, 0);
+    glVertexArrayVertexBuffer(gQueryBoxes.vao, 0, gQueryBoxes.vbo, 0, sizeof(GLfloat) * 3);
+
+    return true;
+}
+
+/* Draws this frame's heavy meshes, each under conditional rendering on its newest finished box query, then queries
+ * their boxes against the finished depth buffer for the frames to come. Only availability is polled, results are
+ * read back for --stats alone.
+ */
+void UDrawQueriedMeshes()
+{
+    gQueryStats = QueryStats();
+    if (gQueryDraws.empty())
+        return;
+
+    UBindVertexArray(gGeometry.vao);
+
+    for (const QueryDraw& draw : gQueryDraws)
+    {
+        MeshQueries& mesh = gQueryBoxes.meshes[gQueryBoxes.slotMeshes[draw.slot]];
+        for (int q = 0; q < QUERY_RING; q++)
+        {
+            if (!mesh.pending[q])
+                continue;
+            GLuint available = 0;
+            glGetQueryObjectuiv(mesh.queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            mesh.pending[q] = false;
+            if (mesh.latest < 0 || mesh.issued[q] > mesh.issued[mesh.latest])
+                mesh.latest = q;
+        }
+
+        // Results too old to trust, say from before the mesh left the view, are ignored
+        bool conditional = mesh.latest >= 0 && mesh.issued[mesh.latest] + QUERY_MAX_AGE >= gFrameIndex;
+        if (conditional)
+        {
+            GLuint query = mesh.queries[mesh.latest];
+            if (gPrintStats)
+            {
+                GLuint passed = 0;
+                glGetQueryObjectuiv(query, GL_QUERY_RESULT, &passed); // Known to be available
+                gQueryStats.resolved++;
+                gQueryStats.hidden += passed == 0;
+            }
+            glBeginConditionalRender(query, GL_QUERY_NO_WAIT);
+        }
+
+        const DrawCommand& command = draw.command;
+        GLuint textureId = gMeshVector[gDrawOrder[draw.slot]].textureId;
+        UUseProgram(UVariantProgram(UMeshVariant(textureId)));
+        UBindTexture(0, textureId);
+        glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+            (void*)(command.firstIndex * sizeof(GLuint)), 1, command.baseVertex, command.baseInstance);
+
+        if (conditional)
+            glEndConditionalRender();
+    }
+
+    // Boxes touch the depth buffer without changing it; faces lying on the mesh's own surface still pass
+    UUseProgram(gQueryBoxes.program);
+    GLint boxMinLoc = UUniformLocation(gQueryBoxes.program, "boxMin");
+    GLint boxSizeLoc = UUniformLocation(gQueryBoxes.program, "boxSize");
+    UBindVertexArray(gQueryBoxes.vao);
+    UColorMask(false);
+    UDepthMask(false);
+    UDepthFunc(GL_LEQUAL);
+    for (const QueryDraw& draw : gQueryDraws)
+    {
+        // A box around the camera is clipped away and would read as hidden, so its mesh goes without a new query
+        const GLMesh& bounds = gMeshVector[gDrawOrder[draw.slot]];
+        glm::vec3 nearMargin(0.1f);
+        if (glm::clamp(gCamera.Position, bounds.boundsMin - nearMargin, bounds.boundsMax + nearMargin) == gCamera.Position)
+            continue;
+
+        // Any query neither in flight nor holding the newest result, none when the GPU is that far behind
+        MeshQueries& mesh = gQueryBoxes.meshes[gQueryBoxes.slotMeshes[draw.slot]];
+        int q = 0;
+        while (q < QUERY_RING && (mesh.pending[q] || q == mesh.latest))
+            q++;
+        if (q == QUERY_RING)
+            continue;
+
+        glUniform3fv(boxMinLoc, 1, glm::value_ptr(bounds.boundsMin));
+        glUniform3fv(boxSizeLoc, 1, glm::value_ptr(bounds.boundsMax - bounds.boundsMin));
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, mesh.queries[q]);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        mesh.issued[q] = gFrameIndex;
+        mesh.pending[q] = true;
+        gQueryStats.issued++;
+    }
+    UDepthFunc(GL_LESS);
+    UDepthMask(true);
+    UColorMask(true);
+}
+
+// Destroys the query boxes and every mesh's queries
+void UDestroyQueryBoxes()
+{
+    for (MeshQueries& mesh : gQueryBoxes.meshes)
+        glDeleteQueries(QUERY_RING, mesh.queries);
+    glDeleteProgram(gQueryBoxes.program);
+    glDeleteVertexArrays(1, &gQueryBoxes.vao);
+    glDeleteBuffers(1, &gQueryBoxes.vbo);
+    glDeleteBuffers(1, &gQueryBoxes.ebo);
+}
+
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+void UResizeWindow(GLFWwindow* window, int width, int height)
+{
+    UViewport(0, 0, width, height);
 }
\ No newline at end of file
@@ -0,0 +1,136 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/* Baked scene archive, written by --bake and mapped at startup.
+ *
+ *   ArchiveHeader
+ *   vertex blob, index blob, texture levels   each starting on an ARCHIVE_ALIGNMENT boundary
+ *   ArchiveMesh[nMeshes]
+ *   ArchiveTexture[nTextures]
+ *   texture paths                              not terminated, located by offset and length
+ *
+ * Every offset is from the start of the file. Vertices are stored in the layout the archive was baked
+ * for (vertexStride tells which), so they upload without conversion.
+ */
+
+const char ARCHIVE_MAGIC[8] = { 'M', 'S', 'B', 'A', 'K', 'E', '\0', '\0' };
+const uint32_t ARCHIVE_VERSION = 4;
+const uint64_t ARCHIVE_ALIGNMENT = 64;
+const uint32_t ARCHIVE_MAX_LODS = 4;
+const uint32_t ARCHIVE_MAX_LEVELS = 16; // Enough mip levels for a 32768 pixel texture
+const uint32_t ARCHIVE_NO_TEXTURE = 0xffffffff;
+const uint32_t ARCHIVE_MESH_OCCLUDER = 1; // ArchiveMesh::flags bit of meshes drawn into the occlusion buffer
+
+struct ArchiveHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t vertexStride;  // Bytes per vertex of the baked layout
+    uint64_t sceneHash;     // Hash of the scene source and layout the geometry was generated from
+    uint32_t nMeshes;
+    uint32_t nTextures;
+    uint64_t meshOffset;
+    uint64_t textureOffset;
+    uint64_t pathOffset;
+    uint64_t pathSize;
+    uint64_t vertexOffset;
+    uint64_t vertexSize;
+    uint64_t indexOffset;
+    uint64_t indexSize;
+};
+
+struct ArchiveLod
+{
+    uint32_t baseVertex;
+    uint32_t firstIndex;
+    uint32_t nIndices;
+    float error;
+};
+
+struct ArchiveMesh
+{
+    ArchiveLod lods[ARCHIVE_MAX_LODS];
+    uint32_t nLods;
+    uint32_t texture;       // Index into the texture table, or ARCHIVE_NO_TEXTURE
+    float boundsMin[3];
+    float boundsMax[3];
+    float sphere[4];        // Bounding sphere center and radius
+    uint32_t flags;         // ARCHIVE_MESH_ bits
+    uint32_t reserved;
+};
+
+struct ArchiveLevel // One mip level, tightly packed rows
+{
+    uint64_t offset;
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct ArchiveTexture
+{
+    uint64_t sourceHash;    // Hash of the source image file, an unchanged file is copied on the next bake
+    uint32_t pathOffset;    // Source path inside the path block
+    uint32_t pathLength;
+    uint32_t channels;
+    uint32_t nLevels;
+    uint32_t embedded;      // Image stored inside a model, its hash only changes with the model
+    uint32_t lighting;      // SceneLighting of the surfaces using it, 0 (Phong) in archives baked before it existed
+    ArchiveLevel levels[ARCHIVE_MAX_LEVELS];
+};
+
+static_assert(sizeof(ArchiveHeader) % 8 == 0 && sizeof(ArchiveMesh) % 8 == 0 && sizeof(ArchiveTexture) % 8 == 0,
+    "archive records must keep the tables after them 8 byte aligned");
+
+// 64 bit FNV-1a, chained through seed to hash several buffers as one
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline uint64_t AlignArchiveOffset(uint64_t offset)
+{
+    return (offset + ARCHIVE_ALIGNMENT - 1) & ~(ARCHIVE_ALIGNMENT - 1);
+}
+
+/* Halves an image with a 2x2 box filter. Odd sizes drop the last row or column, as GL mip chains do.
+ * The result is width / 2 by height / 2, never smaller than 1 by 1.
+ */
+inline void DownsampleLevel(const unsigned char* src, uint32_t width, uint32_t height, uint32_t channels, std::vector<unsigned char>& dst)
+{
+    uint32_t dstWidth = width > 1 ? width / 2 : 1;
+    uint32_t dstHeight = height > 1 ? height / 2 : 1;
+    dst.resize((size_t)dstWidth * dstHeight * channels);
+
+    for (uint32_t y = 0; y < dstHeight; y++)
+    {
+        uint32_t y0 = std::min(2 * y, height - 1);
+        uint32_t y1 = std::min(2 * y + 1, height - 1);
+        for (uint32_t x = 0; x < dstWidth; x++)
+        {
+            uint32_t x0 = std::min(2 * x, width - 1);
+            uint32_t x1 = std::min(2 * x + 1, width - 1);
+            for (uint32_t c = 0; c < channels; c++)
+            {
+                uint32_t sum = src[((size_t)y0 * width + x0) * channels + c] + src[((size_t)y0 * width + x1) * channels + c]
+                             + src[((size_t)y1 * width + x0) * channels + c] + src[((size_t)y1 * width + x1) * channels + c];
+                dst[((size_t)y * dstWidth + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,376 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/* Bounding volume hierarchy over axis aligned boxes, built with a binned surface area heuristic.
+ * Items are numbered 0..n-1 by the caller. Nodes live in one array with children always after their parent,
+ * so a refit is a single backwards sweep, and queries walk it with an explicit stack.
+ */
+
+const uint32_t BVH_BINS = 12;       // Split candidates tried per axis
+const uint32_t BVH_MAX_LEAF = 4;    // Leaves never hold more items than this
+
+struct BvhNode
+{
+    glm::vec3 boundsMin;
+    uint32_t leftOrFirst; // Left child (the right one follows it), or the leaf's first entry in Bvh::items
+    glm::vec3 boundsMax;
+    uint32_t count;       // Items in a leaf, 0 for inner nodes
+};
+
+// Distance along the ray to where it enters the box, or FLT_MAX when it misses. inverseDirection is 1 / direction.
+inline float RayBoxEntry(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float maxDistance)
+{
+    float tMin = 0.0f, tMax = maxDistance;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float t0 = (boundsMin[axis] - origin[axis]) * inverseDirection[axis];
+        float t1 = (boundsMax[axis] - origin[axis]) * inverseDirection[axis];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        tMin = std::max(tMin, t0);
+        tMax = std::min(tMax, t1);
+        if (tMin > tMax)
+            return FLT_MAX;
+    }
+    return tMin;
+}
+
+class Bvh
+{
+public:
+    std::vector<BvhNode> nodes;
+    std::vector<uint32_t> items;                    // Leaf contents, each leaf owns a contiguous run
+    std::vector<glm::vec3> itemMin, itemMax;        // Current box of every item
+
+    // Builds the tree from scratch over n boxes
+    void build(const glm::vec3* boundsMin, const glm::vec3* boundsMax, size_t n)
+    {
+        itemMin.assign(boundsMin, boundsMin + n);
+        itemMax.assign(boundsMax, boundsMax + n);
+        items.resize(n);
+        for (uint32_t i = 0; i < n; i++)
+            items[i] = i;
+
+        nodes.clear();
+        if (n == 0)
+            return;
+        nodes.reserve(2 * n);
+        nodes.push_back({ glm::vec3(0.0f), 0, glm::vec3(0.0f), (uint32_t)n });
+
+        std::vector<uint32_t> pending = { 0 };
+        while (!pending.empty())
+        {
+            uint32_t nodeIndex = pending.back();
+            pending.pop_back();
+            updateBounds(nodes[nodeIndex]);
+            if (split(nodeIndex))
+            {
+                pending.push_back(nodes[nodeIndex].leftOrFirst);
+                pending.push_back(nodes[nodeIndex].leftOrFirst + 1);
+            }
+        }
+    }
+
+    // Moves one item; call refit once after moving any number of them
+    void update(uint32_t item, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        itemMin[item] = boundsMin;
+        itemMax[item] = boundsMax;
+    }
+
+    /* Recomputes every node's box bottom up, keeping the tree's shape. Much cheaper than a build and fine while
+     * items move a little; after large moves the tree gets loose and a rebuild pays off again.
+     */
+    void refit()
+    {
+        for (size_t i = nodes.size(); i-- > 0;)
+        {
+            BvhNode& node = nodes[i];
+            if (node.count > 0)
+                updateBounds(node);
+            else
+            {
+                const BvhNode& left = nodes[node.leftOrFirst];
+                const BvhNode& right = nodes[node.leftOrFirst + 1];
+                node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+                node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+            }
+        }
+    }
+
+    /* Sets visible[item] to 1 for each item whose box touches the frustum (planes as from ExtractFrustumPlanes).
+     * Entries of culled items are left alone. A subtree entirely inside some planes stops testing against them,
+     * and one entirely inside all six is accepted without further tests. Returns the number of visible items.
+     */
+    size_t cullFrustum(const glm::vec4 planes[6], uint8_t* visible) const
+    {
+        if (nodes.empty())
+            return 0;
+
+        size_t nVisible = 0;
+        struct Entry { uint32_t node; uint32_t planeMask; };
+        std::vector<Entry> stack = { { 0, 0x3f } };
+        while (!stack.empty())
+        {
+            Entry entry = stack.back();
+            stack.pop_back();
+            const BvhNode& node = nodes[entry.node];
+            uint32_t planeMask = entry.planeMask;
+            if (planeMask != 0 && !clipBox(planes, node.boundsMin, node.boundsMax, planeMask))
+                continue;
+
+            if (node.count > 0)
+            {
+                for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+                {
+                    uint32_t item = items[i];
+                    uint32_t itemMask = planeMask;
+                    if (itemMask == 0 || clipBox(planes, itemMin[item], itemMax[item], itemMask))
+                    {
+                        visible[item] = 1;
+                        nVisible++;
+                    }
+                }
+                continue;
+            }
+            stack.push_back({ node.leftOrFirst, planeMask });
+            stack.push_back({ node.leftOrFirst + 1, planeMask });
+        }
+        return nVisible;
+    }
+
+    /* Finds the nearest item along a ray within maxDistance. intersect(item, maxDistance) returns the item's hit
+     * distance or FLT_MAX for a miss, and is only asked about items whose box the ray enters before the best hit
+     * so far. Nearer children are visited first so far ones are mostly skipped.
+     */
+    template <typename Intersect>
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Intersect intersect, uint32_t& hitItem, float& hitDistance) const
+    {
+        hitDistance = maxDistance;
+        bool hit = false;
+        if (nodes.empty())
+            return false;
+
+        glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+        std::vector<uint32_t> stack = { 0 };
+        while (!stack.empty())
+        {
+            const BvhNode& node = nodes[stack.back()];
+            stack.pop_back();
+            if (RayBoxEntry(origin, inverseDirection, node.boundsMin, node.boundsMax, hitDistance) == FLT_MAX)
+                continue;
+
+            if (node.count > 0)
+            {
+                for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+                {
+                    float distance = intersect(items[i], hitDistance);
+                    if (distance < hitDistance)
+                    {
+                        hitDistance = distance;
+                        hitItem = items[i];
+                        hit = true;
+                    }
+                }
+                continue;
+            }
+
+            uint32_t nearChild = node.leftOrFirst, farChild = node.leftOrFirst + 1;
+            float nearEntry = RayBoxEntry(origin, inverseDirection, nodes[nearChild].boundsMin, nodes[nearChild].boundsMax, hitDistance);
+            float farEntry = RayBoxEntry(origin, inverseDirection, nodes[farChild].boundsMin, nodes[farChild].boundsMax, hitDistance);
+            if (farEntry < nearEntry)
+            {
+                std::swap(nearChild, farChild);
+                std::swap(nearEntry, farEntry);
+            }
+            if (farEntry != FLT_MAX)
+                stack.push_back(farChild);
+            if (nearEntry != FLT_MAX)
+                stack.push_back(nearChild);
+        }
+        return hit;
+    }
+
+    // Appends every item whose box overlaps the query box
+    void overlap(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<uint32_t>& result) const
+    {
+        if (nodes.empty())
+            return;
+
+        std::vector<uint32_t> stack = { 0 };
+        while (!stack.empty())
+        {
+            const BvhNode& node = nodes[stack.back()];
+            stack.pop_back();
+            if (!boxesOverlap(node.boundsMin, node.boundsMax, boundsMin, boundsMax))
+                continue;
+
+            if (node.count > 0)
+            {
+                for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+                {
+                    if (boxesOverlap(itemMin[items[i]], itemMax[items[i]], boundsMin, boundsMax))
+                        result.push_back(items[i]);
+                }
+                continue;
+            }
+            stack.push_back(node.leftOrFirst);
+            stack.push_back(node.leftOrFirst + 1);
+        }
+    }
+
+private:
+    static bool boxesOverlap(const glm::vec3& aMin, const glm::vec3& aMax, const glm::vec3& bMin, const glm::vec3& bMax)
+    {
+        return aMin.x <= bMax.x && aMax.x >= bMin.x && aMin.y <= bMax.y && aMax.y >= bMin.y && aMin.z <= bMax.z && aMax.z >= bMin.z;
+    }
+
+    static float surfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        glm::vec3 size = boundsMax - boundsMin;
+        return size.x * size.y + size.y * size.z + size.z * size.x;
+    }
+
+    /* Tests a box against the planes in planeMask. Returns false when it is entirely outside one of them,
+     * otherwise clears the planes it is entirely inside of from the mask.
+     */
+    static bool clipBox(const glm::vec4 planes[6], const glm::vec3& boundsMin, const glm::vec3& boundsMax, uint32_t& planeMask)
+    {
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+        for (int p = 0; p < 6; p++)
+        {
+            if (!(planeMask & (1u << p)))
+                continue;
+
+            const glm::vec4& plane = planes[p];
+            float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+            float reach = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z;
+            if (distance + reach < 0.0f)
+                return false;
+            if (distance - reach >= 0.0f)
+                planeMask &= ~(1u << p);
+        }
+        return true;
+    }
+
+    void updateBounds(BvhNode& node) const
+    {
+        node.boundsMin = glm::vec3(FLT_MAX);
+        node.boundsMax = glm::vec3(-FLT_MAX);
+        for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+        {
+            node.boundsMin = glm::min(node.boundsMin, itemMin[items[i]]);
+            node.boundsMax = glm::max(node.boundsMax, itemMax[items[i]]);
+        }
+    }
+
+    // Splits a leaf at the cheapest binned SAH plane; returns false when it is better left as a leaf
+    bool split(uint32_t nodeIndex)
+    {
+        BvhNode& node = nodes[nodeIndex];
+        if (node.count <= 1)
+            return false;
+
+        glm::vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+        for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+        {
+            glm::vec3 centroid = (itemMin[items[i]] + itemMax[items[i]]) * 0.5f;
+            centroidMin = glm::min(centroidMin, centroid);
+            centroidMax = glm::max(centroidMax, centroid);
+        }
+
+        int bestAxis = -1;
+        uint32_t bestBin = 0;
+        float bestCost = FLT_MAX;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float extent = centroidMax[axis] - centroidMin[axis];
+            if (extent <= 0.0f)
+                continue;
+
+            struct Bin { glm::vec3 boundsMin = glm::vec3(FLT_MAX), boundsMax = glm::vec3(-FLT_MAX); uint32_t count = 0; };
+            Bin bins[BVH_BINS];
+            float scale = BVH_BINS / extent;
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+            {
+                float centroid = (itemMin[items[i]][axis] + itemMax[items[i]][axis]) * 0.5f;
+                Bin& bin = bins[std::min(BVH_BINS - 1, (uint32_t)((centroid - centroidMin[axis]) * scale))];
+                bin.boundsMin = glm::min(bin.boundsMin, itemMin[items[i]]);
+                bin.boundsMax = glm::max(bin.boundsMax, itemMax[items[i]]);
+                bin.count++;
+            }
+
+            // Sweep from both ends so every plane's two sides cost one pass each
+            float leftArea[BVH_BINS - 1], rightArea[BVH_BINS - 1];
+            uint32_t leftCount[BVH_BINS - 1], rightCount[BVH_BINS - 1];
+            glm::vec3 leftMin(FLT_MAX), leftMax(-FLT_MAX), rightMin(FLT_MAX), rightMax(-FLT_MAX);
+            uint32_t leftSum = 0, rightSum = 0;
+            for (uint32_t b = 0; b < BVH_BINS - 1; b++)
+            {
+                leftSum += bins[b].count;
+                leftCount[b] = leftSum;
+                leftMin = glm::min(leftMin, bins[b].boundsMin);
+                leftMax = glm::max(leftMax, bins[b].boundsMax);
+                leftArea[b] = leftSum ? surfaceArea(leftMin, leftMax) : 0.0f;
+
+                uint32_t r = BVH_BINS - 1 - b;
+                rightSum += bins[r].count;
+                rightCount[r - 1] = rightSum;
+                rightMin = glm::min(rightMin, bins[r].boundsMin);
+                rightMax = glm::max(rightMax, bins[r].boundsMax);
+                rightArea[r - 1] = rightSum ? surfaceArea(rightMin, rightMax) : 0.0f;
+            }
+            for (uint32_t b = 0; b < BVH_BINS - 1; b++)
+            {
+                if (leftCount[b] == 0 || rightCount[b] == 0)
+                    continue;
+                float cost = leftCount[b] * leftArea[b] + rightCount[b] * rightArea[b];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+
+        // Keep the leaf when no plane beats testing every item, unless it holds too many
+        float leafCost = node.count * surfaceArea(node.boundsMin, node.boundsMax);
+        if (node.count <= BVH_MAX_LEAF && (bestAxis < 0 || bestCost >= leafCost))
+            return false;
+
+        // Partition in place, falling back to a median split when every centroid is the same
+        uint32_t first = node.leftOrFirst, count = node.count;
+        uint32_t middle;
+        if (bestAxis >= 0)
+        {
+            float scale = BVH_BINS / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+            auto isLeft = [&](uint32_t item)
+            {
+                float centroid = (itemMin[item][bestAxis] + itemMax[item][bestAxis]) * 0.5f;
+                return std::min(BVH_BINS - 1, (uint32_t)((centroid - centroidMin[bestAxis]) * scale)) <= bestBin;
+            };
+            middle = (uint32_t)(std::partition(items.begin() + first, items.begin() + first + count, isLeft) - items.begin());
+        }
+        else
+            middle = first + count / 2;
+
+        uint32_t leftIndex = (uint32_t)nodes.size();
+        nodes.push_back({ glm::vec3(0.0f), first, glm::vec3(0.0f), middle - first });
+        nodes.push_back({ glm::vec3(0.0f), middle, glm::vec3(0.0f), first + count - middle });
+        nodes[nodeIndex].leftOrFirst = leftIndex; // node may have moved with the push_backs
+        nodes[nodeIndex].count = 0;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CULLING_SSE
+#include <xmmintrin.h>
+#endif
+
+/* View frustum culling of bounding spheres and boxes.
+ * Bounds are kept as a structure of arrays so the SSE path tests four of them per plane at once;
+ * builds without SSE fall back to the same tests one bound at a time.
+ */
+
+const size_t CULL_LANES = 4; // Bounds tested per SIMD step, CullBounds pads to a multiple of it
+const float CULL_REUSE_DISTANCE = 0.05f; // Camera travel, in world units, a full pass's results stay valid for
+const float CULL_REUSE_ANGLE = 0.01f;    // Camera rotation, in radians, likewise
+
+/* Extracts the six clip planes of a view projection matrix (Gribb and Hartmann), normals pointing inward
+ * and normalized, so plane.xyz . p + plane.w is a signed distance.
+ */
+inline void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; r++)
+        rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+
+    planes[0] = rows[3] + rows[0]; // Left
+    planes[1] = rows[3] - rows[0]; // Right
+    planes[2] = rows[3] + rows[1]; // Bottom
+    planes[3] = rows[3] - rows[1]; // Top
+    planes[4] = rows[3] + rows[2]; // Near
+    planes[5] = rows[3] - rows[2]; // Far
+    for (int p = 0; p < 6; p++)
+        planes[p] /= glm::length(glm::vec3(planes[p]));
+}
+
+struct CullBounds // Every drawable's bounds, one array per component
+{
+    std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+    std::vector<float> boxX, boxY, boxZ;          // Box centers
+    std::vector<float> extentX, extentY, extentZ; // Box half sizes
+    size_t count = 0;
+
+    // Padding lanes get a negative infinite radius, which no plane test passes
+    void resize(size_t n)
+    {
+        count = n;
+        size_t padded = (n + CULL_LANES - 1) / CULL_LANES * CULL_LANES;
+        for (std::vector<float>* component : { &sphereX, &sphereY, &sphereZ, &boxX, &boxY, &boxZ, &extentX, &extentY, &extentZ })
+            component->assign(padded, 0.0f);
+        sphereRadius.assign(padded, -FLT_MAX);
+    }
+
+    void set(size_t i, const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::vec3& sphereCenter, float radius)
+    {
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+        sphereX[i] = sphereCenter.x;
+        sphereY[i] = sphereCenter.y;
+        sphereZ[i] = sphereCenter.z;
+        sphereRadius[i] = radius;
+        boxX[i] = center.x;
+        boxY[i] = center.y;
+        boxZ[i] = center.z;
+        extentX[i] = extent.x;
+        extentY[i] = extent.y;
+        extentZ[i] = extent.z;
+    }
+};
+
+struct CullStats
+{
+    size_t visible = 0;
+    size_t culled = 0;
+    size_t tested = 0; // Bounds culled afresh this frame, only the unsettled ones when the last full pass was reused
+};
+
+// Exact test of one bound, the same one CullFrustum makes
+inline bool CullBoundVisible(const CullBounds& bounds, size_t i, const glm::vec4 planes[6])
+{
+    for (int p = 0; p < 6; p++)
+    {
+        const glm::vec4& plane = planes[p];
+        // Summed in the SSE path's order so both agree to the last bit
+        float sphereDistance = (plane.x * bounds.sphereX[i] + plane.y * bounds.sphereY[i]) + (plane.z * bounds.sphereZ[i] + plane.w);
+        float boxDistance = (plane.x * bounds.boxX[i] + plane.y * bounds.boxY[i]) + (plane.z * bounds.boxZ[i] + plane.w);
+        float reach = std::fabs(plane.x) * bounds.extentX[i] + std::fabs(plane.y) * bounds.extentY[i] + std::fabs(plane.z) * bounds.extentZ[i];
+        if (sphereDistance <= -bounds.sphereRadius[i] || boxDistance + reach < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+/* Sets visible[i] to 1 for every bound inside or crossing all six planes and to 0 otherwise, returning the visible count.
+ * Both the sphere and the box have to reach inside every plane, so each rejects what the other's looser fit
+ * lets through. visible must hold count entries.
+ */
+inline size_t CullFrustum(const CullBounds& bounds, const glm::vec4 planes[6], uint8_t* visible)
+{
+    size_t nVisible = 0;
+    size_t i = 0;
+
+#ifdef CULLING_SSE
+    const __m128 zero = _mm_setzero_ps();
+    for (; i < bounds.count; i += CULL_LANES) // The arrays are padded, so the last step may read past count
+    {
+        __m128 sx = _mm_loadu_ps(&bounds.sphereX[i]), sy = _mm_loadu_ps(&bounds.sphereY[i]), sz = _mm_loadu_ps(&bounds.sphereZ[i]);
+        __m128 negativeRadius = _mm_sub_ps(zero, _mm_loadu_ps(&bounds.sphereRadius[i]));
+        __m128 bx = _mm_loadu_ps(&bounds.boxX[i]), by = _mm_loadu_ps(&bounds.boxY[i]), bz = _mm_loadu_ps(&bounds.boxZ[i]);
+        __m128 ex = _mm_loadu_ps(&bounds.extentX[i]), ey = _mm_loadu_ps(&bounds.extentY[i]), ez = _mm_loadu_ps(&bounds.extentZ[i]);
+
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 px = _mm_set1_ps(planes[p].x), py = _mm_set1_ps(planes[p].y), pz = _mm_set1_ps(planes[p].z), pw = _mm_set1_ps(planes[p].w);
+            __m128 sphereDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, sx), _mm_mul_ps(py, sy)), _mm_add_ps(_mm_mul_ps(pz, sz), pw));
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(sphereDistance, negativeRadius));
+
+            // Box center distance plus the extent projected onto the plane normal
+            __m128 boxDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, bx), _mm_mul_ps(py, by)), _mm_add_ps(_mm_mul_ps(pz, bz), pw));
+            __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::fabs(planes[p].x)), ex), _mm_mul_ps(_mm_set1_ps(std::fabs(planes[p].y)), ey)),
+                                      _mm_mul_ps(_mm_set1_ps(std::fabs(planes[p].z)), ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(boxDistance, reach), zero));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for (size_t lane = 0; lane < CULL_LANES && i + lane < bounds.count; lane++)
+        {
+            visible[i + lane] = (uint8_t)((mask >> lane) & 1);
+            nVisible += visible[i + lane];
+        }
+    }
+#endif
+
+    for (; i < bounds.count; i++)
+    {
+        visible[i] = CullBoundVisible(bounds, i, planes) ? 1 : 0;
+        nVisible += visible[i];
+    }
+
+    return nVisible;
+}
+
+/* Frame to frame reuse of a full culling pass.
+ * After a full pass, CullCacheSettle sorts the bounds into settled ones, whose sphere is far enough inside all
+ * planes or outside one that a camera within CULL_REUSE_DISTANCE and CULL_REUSE_ANGLE of that pass cannot change
+ * the answer, and unsettled ones. While the camera stays that close, CullCacheUpdate re-tests only the unsettled
+ * bounds and anything marked as moved, so a still or slowly moving view costs a handful of tests.
+ */
+struct CullCache
+{
+    bool valid = false;
+    glm::mat4 view = glm::mat4(1.0f);       // Camera of the last full pass
+    glm::mat4 projection = glm::mat4(1.0f);
+    std::vector<uint32_t> unsettled;        // Bounds re-tested every frame until the next full pass
+    std::vector<uint8_t> isUnsettled;
+    size_t nVisible = 0;
+};
+
+// Whether the camera is still close enough to the last full pass's to reuse it
+inline bool CullCacheUsable(const CullCache& cache, const glm::mat4& view, const glm::mat4& projection)
+{
+    if (!cache.valid || projection != cache.projection)
+        return false;
+
+    // Camera positions out of the view matrices, and the angle of the rotation between them
+    glm::mat3 rotation(view), cachedRotation(cache.view);
+    glm::vec3 position = -(glm::transpose(rotation) * glm::vec3(view[3]));
+    glm::vec3 cachedPosition = -(glm::transpose(cachedRotation) * glm::vec3(cache.view[3]));
+    glm::mat3 relative = rotation * glm::transpose(cachedRotation);
+    float cosAngle = (relative[0][0] + relative[1][1] + relative[2][2] - 1.0f) * 0.5f;
+    return glm::length(position - cachedPosition) <= CULL_REUSE_DISTANCE && cosAngle >= std::cos(CULL_REUSE_ANGLE);
+}
+
+// Records a full pass's camera and sorts every bound into settled or unsettled
+inline void CullCacheSettle(CullCache& cache, const CullBounds& bounds, const glm::vec4 planes[6], const glm::mat4& view, const glm::mat4& projection, size_t nVisible)
+{
+    cache.valid = true;
+    cache.view = view;
+    cache.projection = projection;
+    cache.nVisible = nVisible;
+    cache.unsettled.clear();
+    cache.isUnsettled.assign(bounds.count, 0);
+
+    glm::vec3 cameraPosition = -(glm::transpose(glm::mat3(view)) * glm::vec3(view[3]));
+    for (size_t i = 0; i < bounds.count; i++)
+    {
+        // A plane moves by at most the travel plus the rotation times the distance from the camera
+        glm::vec3 center(bounds.sphereX[i], bounds.sphereY[i], bounds.sphereZ[i]);
+        float radius = bounds.sphereRadius[i];
+        float margin = CULL_REUSE_DISTANCE + CULL_REUSE_ANGLE * (glm::length(center - cameraPosition) + radius);
+
+        // Settled when well inside every plane, or well outside any one of them
+        bool inside = true, outside = false;
+        for (int p = 0; p < 6 && !outside; p++)
+        {
+            float distance = glm::dot(glm::vec3(planes[p]), center) + planes[p].w;
+            outside = distance < -radius - margin;
+            inside = inside && distance > radius + margin;
+        }
+        if (!inside && !outside)
+        {
+            cache.unsettled.push_back((uint32_t)i);
+            cache.isUnsettled[i] = 1;
+        }
+    }
+}
+
+// Reuses the last full pass, re-testing only the unsettled bounds. visible must still hold that pass's results.
+inline size_t CullCacheUpdate(CullCache& cache, const CullBounds& bounds, const glm::vec4 planes[6], uint8_t* visible)
+{
+    for (uint32_t i : cache.unsettled)
+    {
+        uint8_t inside = CullBoundVisible(bounds, i, planes) ? 1 : 0;
+        cache.nVisible += inside;
+        cache.nVisible -= visible[i];
+        visible[i] = inside;
+    }
+    return cache.nVisible;
+}
+
+// A bound that changed since the last full pass is re-tested every frame from now on
+inline void CullCacheMarkMoved(CullCache& cache, size_t i)
+{
+    if (cache.valid && !cache.isUnsettled[i])
+    {
+        cache.unsettled.push_back((uint32_t)i);
+        cache.isUnsettled[i] = 1;
+    }
+}
+
+#endif
@@ -0,0 +1,616 @@
+#ifndef GLTF_IMPORT_H
+#define GLTF_IMPORT_H
+
+#include <glm/glm.hpp>
+
+#include <model.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* Binary glTF 2.0 (.glb) importer.
+ * The file is mapped and accessors are read where they lie in the BIN chunk. Tightly packed 32 bit index
+ * accessors are handed out as is, embedded images are returned as byte ranges for the texture loader.
+ * Node transforms of the default scene are applied, every triangle primitive becomes one mesh.
+ */
+
+struct JsonValue
+{
+    enum Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> items;                           // Array elements
+    std::vector<std::pair<std::string, JsonValue>> members; // Object members in file order
+
+    const JsonValue* find(const char* key) const
+    {
+        for (const auto& member : members)
+        {
+            if (member.first == key)
+                return &member.second;
+        }
+        return nullptr;
+    }
+
+    double numberOr(const char* key, double fallback) const
+    {
+        const JsonValue* value = find(key);
+        return value && value->type == Number ? value->number : fallback;
+    }
+
+    // Non-negative integer, or SIZE_MAX so that it never names an element
+    size_t asIndex() const
+    {
+        return type == Number && number >= 0.0 ? (size_t)number : (size_t)-1;
+    }
+
+    size_t indexOr(const char* key) const
+    {
+        const JsonValue* value = find(key);
+        return value ? value->asIndex() : (size_t)-1;
+    }
+
+    // Element i of the array under key, or nullptr
+    const JsonValue* at(const char* key, size_t i) const
+    {
+        const JsonValue* array = find(key);
+        return array && array->type == Array && i < array->items.size() ? &array->items[i] : nullptr;
+    }
+};
+
+// Recursive descent JSON reader, enough for glTF documents
+class JsonParser
+{
+public:
+    JsonParser(const char* begin, const char* end) : p(begin), end(end) {}
+
+    bool parse(JsonValue& value)
+    {
+        return parseValue(value, 0) && (skipSpace(), p == end);
+    }
+
+private:
+    const char* p;
+    const char* end;
+
+    static const int MAX_DEPTH = 128;
+
+    void skipSpace()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == '\0'))
+            p++;
+    }
+
+    bool literal(const char* word)
+    {
+        size_t length = strlen(word);
+        if ((size_t)(end - p) < length || memcmp(p, word, length) != 0)
+            return false;
+        p += length;
+        return true;
+    }
+
+    bool parseString(std::string& out)
+    {
+        if (p >= end || *p != '"')
+            return false;
+        p++;
+        while (p < end && *p != '"')
+        {
+            char c = *p++;
+            if (c != '\\')
+            {
+                out += c;
+                continue;
+            }
+            if (p >= end)
+                return false;
+
+            c = *p++;
+            switch (c)
+            {
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u':
+            {
+                if (end - p < 4)
+                    return false;
+                unsigned int code = (unsigned int)strtoul(std::string(p, 4).c_str(), nullptr, 16);
+                p += 4;
+                // Basic multilingual plane only, encoded as UTF-8
+                if (code < 0x80)
+                    out += (char)code;
+                else if (code < 0x800)
+                {
+                    out += (char)(0xc0 | (code >> 6));
+                    out += (char)(0x80 | (code & 0x3f));
+                }
+                else
+                {
+                    out += (char)(0xe0 | (code >> 12));
+                    out += (char)(0x80 | ((code >> 6) & 0x3f));
+                    out += (char)(0x80 | (code & 0x3f));
+                }
+                break;
+            }
+            default: out += c; break;
+            }
+        }
+        if (p >= end)
+            return false;
+        p++;
+        return true;
+    }
+
+    bool parseValue(JsonValue& value, int depth)
+    {
+        skipSpace();
+        if (p >= end || depth > MAX_DEPTH)
+            return false;
+
+        if (*p == '{')
+        {
+            value.type = JsonValue::Object;
+            p++;
+            skipSpace();
+            if (p < end && *p == '}')
+            {
+                p++;
+                return true;
+            }
+            while (true)
+            {
+                std::pair<std::string, JsonValue> member;
+                skipSpace();
+                if (!parseString(member.first))
+                    return false;
+                skipSpace();
+                if (p >= end || *p++ != ':' || !parseValue(member.second, depth + 1))
+                    return false;
+                value.members.push_back(std::move(member));
+                skipSpace();
+                if (p < end && *p == ',')
+                    p++;
+                else if (p < end && *p == '}')
+                {
+                    p++;
+                    return true;
+                }
+                else
+                    return false;
+            }
+        }
+        if (*p == '[')
+        {
+            value.type = JsonValue::Array;
+            p++;
+            skipSpace();
+            if (p < end && *p == ']')
+            {
+                p++;
+                return true;
+            }
+            while (true)
+            {
+                value.items.emplace_back();
+                if (!parseValue(value.items.back(), depth + 1))
+                    return false;
+                skipSpace();
+                if (p < end && *p == ',')
+                    p++;
+                else if (p < end && *p == ']')
+                {
+                    p++;
+                    return true;
+                }
+                else
+                    return false;
+            }
+        }
+        if (*p == '"')
+        {
+            value.type = JsonValue::String;
+            return parseString(value.string);
+        }
+        if (literal("true"))
+        {
+            value.type = JsonValue::Bool;
+            value.boolean = true;
+            return true;
+        }
+        if (literal("false"))
+        {
+            value.type = JsonValue::Bool;
+            return true;
+        }
+        if (literal("null"))
+            return true;
+
+        // Numbers are copied out because the mapped JSON chunk is not null terminated
+        const char* start = p;
+        while (p < end && ((*p && strchr("+-.eE", *p)) || (*p >= '0' && *p <= '9')))
+            p++;
+        if (p == start)
+            return false;
+        value.type = JsonValue::Number;
+        value.number = strtod(std::string(start, p).c_str(), nullptr);
+        return true;
+    }
+};
+
+const uint32_t GLB_MAGIC = 0x46546c67;      // "glTF"
+const uint32_t GLB_CHUNK_JSON = 0x4e4f534a; // "JSON"
+const uint32_t GLB_CHUNK_BIN = 0x004e4942;  // "BIN\0"
+
+const int GLTF_UNSIGNED_BYTE = 5121;
+const int GLTF_UNSIGNED_SHORT = 5123;
+const int GLTF_UNSIGNED_INT = 5125;
+const int GLTF_FLOAT = 5126;
+const int GLTF_TRIANGLES = 4;
+
+// Typed view of one accessor inside the BIN chunk
+struct GltfAccessor
+{
+    const unsigned char* data = nullptr;
+    size_t count = 0;
+    size_t stride = 0;
+    int componentType = 0;
+    int components = 0;
+};
+
+inline int GltfComponentSize(int componentType)
+{
+    switch (componentType)
+    {
+    case GLTF_UNSIGNED_BYTE: return 1;
+    case GLTF_UNSIGNED_SHORT: return 2;
+    case GLTF_UNSIGNED_INT: case GLTF_FLOAT: return 4;
+    default: return 0;
+    }
+}
+
+inline int GltfComponentCount(const std::string& type)
+{
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    return 0;
+}
+
+// Resolves an accessor and checks that every element it covers lies inside the BIN chunk
+inline bool GltfReadAccessor(const JsonValue& document, size_t index, const unsigned char* bin, size_t binSize, GltfAccessor& accessor)
+{
+    const JsonValue* json = document.at("accessors", index);
+    if (!json)
+        return false;
+    const JsonValue* view = document.at("bufferViews", json->indexOr("bufferView"));
+    const JsonValue* type = json->find("type");
+    if (!view || !type || view->numberOr("buffer", 0) != 0)
+        return false;
+
+    accessor.componentType = (int)json->numberOr("componentType", 0);
+    accessor.components = GltfComponentCount(type->string);
+    accessor.count = (size_t)json->numberOr("count", 0);
+    size_t elementSize = (size_t)GltfComponentSize(accessor.componentType) * accessor.components;
+    if (elementSize == 0)
+        return false;
+
+    size_t viewOffset = (size_t)view->numberOr("byteOffset", 0);
+    size_t viewLength = (size_t)view->numberOr("byteLength", 0);
+    size_t offset = (size_t)json->numberOr("byteOffset", 0);
+    accessor.stride = (size_t)view->numberOr("byteStride", 0);
+    if (accessor.stride == 0)
+        accessor.stride = elementSize;
+
+    if (viewOffset > binSize || viewLength > binSize - viewOffset)
+        return false;
+    if (accessor.count > 0 && offset + (accessor.count - 1) * accessor.stride + elementSize > viewLength)
+        return false;
+
+    accessor.data = bin + viewOffset + offset;
+    return true;
+}
+
+inline float GltfFloat(const GltfAccessor& accessor, size_t element, int component)
+{
+    float value;
+    memcpy(&value, accessor.data + element * accessor.stride + component * sizeof(float), sizeof(value));
+    return value;
+}
+
+inline uint32_t GltfIndex(const GltfAccessor& accessor, size_t element)
+{
+    const unsigned char* at = accessor.data + element * accessor.stride;
+    if (accessor.componentType == GLTF_UNSIGNED_BYTE)
+        return *at;
+    if (accessor.componentType == GLTF_UNSIGNED_SHORT)
+    {
+        uint16_t value;
+        memcpy(&value, at, sizeof(value));
+        return value;
+    }
+    uint32_t value;
+    memcpy(&value, at, sizeof(value));
+    return value;
+}
+
+// Local transform of a node: its matrix, or translation * rotation * scale
+inline glm::mat4 GltfNodeTransform(const JsonValue& node)
+{
+    glm::mat4 transform(1.0f);
+    const JsonValue* matrix = node.find("matrix");
+    if (matrix && matrix->items.size() == 16)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            transform[column] = glm::vec4((float)matrix->items[column * 4].number, (float)matrix->items[column * 4 + 1].number,
+                                          (float)matrix->items[column * 4 + 2].number, (float)matrix->items[column * 4 + 3].number);
+        }
+        return transform;
+    }
+
+    const JsonValue* t = node.find("translation");
+    const JsonValue* r = node.find("rotation");
+    const JsonValue* s = node.find("scale");
+    if (r && r->items.size() == 4)
+    {
+        float x = (float)r->items[0].number, y = (float)r->items[1].number, z = (float)r->items[2].number, w = (float)r->items[3].number;
+        transform[0] = glm::vec4(1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w), 0.0f);
+        transform[1] = glm::vec4(2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w), 0.0f);
+        transform[2] = glm::vec4(2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y), 0.0f);
+    }
+    if (s && s->items.size() == 3)
+    {
+        for (int i = 0; i < 3; i++)
+            transform[i] *= (float)s->items[i].number;
+    }
+    if (t && t->items.size() == 3)
+        transform[3] = glm::vec4((float)t->items[0].number, (float)t->items[1].number, (float)t->items[2].number, 1.0f);
+    return transform;
+}
+
+// Converts one triangle primitive into a mesh
+inline bool GltfImportPrimitive(const JsonValue& document, const JsonValue& primitive, const unsigned char* bin, size_t binSize,
+    const glm::mat4& transform, const std::string& directory, ImportedMesh& mesh)
+{
+    const JsonValue* attributes = primitive.find("attributes");
+    if (!attributes || primitive.numberOr("mode", GLTF_TRIANGLES) != GLTF_TRIANGLES)
+        return false;
+
+    GltfAccessor positions, normals, uvs, indices;
+    if (!GltfReadAccessor(document, attributes->indexOr("POSITION"), bin, binSize, positions)
+        || positions.componentType != GLTF_FLOAT || positions.components != 3)
+        return false;
+    bool hasNormals = GltfReadAccessor(document, attributes->indexOr("NORMAL"), bin, binSize, normals)
+        && normals.componentType == GLTF_FLOAT && normals.components == 3 && normals.count == positions.count;
+    bool hasUvs = GltfReadAccessor(document, attributes->indexOr("TEXCOORD_0"), bin, binSize, uvs)
+        && uvs.componentType == GLTF_FLOAT && uvs.components == 2 && uvs.count == positions.count;
+
+    // Packed, aligned 32 bit indices are used in place; anything else is widened
+    if (primitive.find("indices"))
+    {
+        if (!GltfReadAccessor(document, primitive.indexOr("indices"), bin, binSize, indices) || indices.components != 1)
+            return false;
+        if (indices.componentType == GLTF_UNSIGNED_INT && indices.stride == sizeof(uint32_t) && (uintptr_t)indices.data % alignof(uint32_t) == 0)
+            mesh.indices = (const uint32_t*)indices.data;
+        else
+        {
+            mesh.ownedIndices.resize(indices.count);
+            for (size_t i = 0; i < indices.count; i++)
+                mesh.ownedIndices[i] = GltfIndex(indices, i);
+            mesh.indices = mesh.ownedIndices.data();
+        }
+        mesh.nIndices = indices.count;
+    }
+    else
+    {
+        mesh.ownedIndices.resize(positions.count);
+        for (size_t i = 0; i < positions.count; i++)
+            mesh.ownedIndices[i] = (uint32_t)i;
+        mesh.indices = mesh.ownedIndices.data();
+        mesh.nIndices = positions.count;
+    }
+
+    for (size_t i = 0; i < mesh.nIndices; i++)
+    {
+        if (mesh.indices[i] >= positions.count)
+            return false;
+    }
+
+    std::vector<float> local(3 * positions.count);
+    for (size_t i = 0; i < positions.count; i++)
+    {
+        for (int c = 0; c < 3; c++)
+            local[3 * i + c] = GltfFloat(positions, i, c);
+    }
+    std::vector<glm::vec3> smoothNormals;
+    if (!hasNormals)
+        ComputeSmoothNormals(local.data(), positions.count, mesh.indices, mesh.nIndices, smoothNormals);
+
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+    mesh.vertices.resize(positions.count * FLOATS_PER_VERTEX);
+    for (size_t i = 0; i < positions.count; i++)
+    {
+        glm::vec3 normal = hasNormals ? glm::vec3(GltfFloat(normals, i, 0), GltfFloat(normals, i, 1), GltfFloat(normals, i, 2)) : smoothNormals[i];
+        // glTF puts the texture origin top left, the loader flips images for GL's bottom left
+        glm::vec2 uv = hasUvs ? glm::vec2(GltfFloat(uvs, i, 0), 1.0f - GltfFloat(uvs, i, 1)) : glm::vec2(0.0f);
+        WriteModelVertex(&mesh.vertices[i * FLOATS_PER_VERTEX], transform, normalMatrix, glm::vec3(local[3 * i], local[3 * i + 1], local[3 * i + 2]), normal, uv);
+    }
+
+    // Base color texture: an embedded image or a file next to the model
+    const JsonValue* material = document.at("materials", primitive.indexOr("material"));
+    const JsonValue* pbr = material ? material->find("pbrMetallicRoughness") : nullptr;
+    const JsonValue* baseColor = pbr ? pbr->find("baseColorTexture") : nullptr;
+    const JsonValue* texture = baseColor ? document.at("textures", baseColor->indexOr("index")) : nullptr;
+    size_t imageIndex = texture ? texture->indexOr("source") : (size_t)-1;
+    const JsonValue* image = document.at("images", imageIndex);
+    if (image)
+    {
+        const JsonValue* uri = image->find("uri");
+        if (image->find("bufferView"))
+            mesh.image = (int)imageIndex;
+        else if (uri && uri->string.compare(0, 5, "data:") != 0)
+            mesh.texture = directory + uri->string;
+    }
+    return true;
+}
+
+// Walks a node and its children, importing every mesh they reference
+inline bool GltfImportNode(const JsonValue& document, size_t nodeIndex, const glm::mat4& parent, const unsigned char* bin, size_t binSize,
+    const std::string& directory, ImportedModel& model, int depth)
+{
+    const JsonValue* node = document.at("nodes", nodeIndex);
+    if (!node || depth > 64)
+        return false;
+
+    glm::mat4 transform = parent * GltfNodeTransform(*node);
+    const JsonValue* mesh = document.at("meshes", node->indexOr("mesh"));
+    const JsonValue* primitives = mesh ? mesh->find("primitives") : nullptr;
+    if (primitives)
+    {
+        for (const JsonValue& primitive : primitives->items)
+        {
+            model.meshes.emplace_back();
+            if (!GltfImportPrimitive(document, primitive, bin, binSize, transform, directory, model.meshes.back()))
+                model.meshes.pop_back();
+        }
+    }
+
+    const JsonValue* children = node->find("children");
+    if (children)
+    {
+        for (const JsonValue& child : children->items)
+        {
+            if (!GltfImportNode(document, child.asIndex(), transform, bin, binSize, directory, model, depth + 1))
+                return false;
+        }
+    }
+    return true;
+}
+
+/* Imports a .glb file with every vertex moved by transform.
+ * Primitives that are not triangle lists or lack float positions are skipped.
+ */
+inline bool ImportGlb(const char* path, const glm::mat4& transform, ImportedModel& model)
+{
+    if (!model.file.open(path))
+    {
+        std::cout << "Failed to open model " << path << std::endl;
+        return false;
+    }
+
+    const unsigned char* data = model.file.data();
+    size_t size = model.file.size();
+    uint32_t header[3];
+    if (size < sizeof(header))
+        return false;
+    memcpy(header, data, sizeof(header));
+    if (header[0] != GLB_MAGIC || header[1] != 2 || header[2] > size)
+    {
+        std::cout << path << " is not a glTF 2.0 binary" << std::endl;
+        return false;
+    }
+
+    // JSON chunk first, then an optional BIN chunk
+    const unsigned char* json = nullptr;
+    const unsigned char* bin = nullptr;
+    size_t jsonSize = 0, binSize = 0;
+    size_t offset = sizeof(header);
+    while (offset + 8 <= header[2])
+    {
+        uint32_t chunk[2];
+        memcpy(chunk, data + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+        if (chunk[0] > header[2] - offset)
+            break;
+        if (chunk[1] == GLB_CHUNK_JSON && !json)
+        {
+            json = data + offset;
+            jsonSize = chunk[0];
+        }
+        else if (chunk[1] == GLB_CHUNK_BIN && !bin)
+        {
+            bin = data + offset;
+            binSize = chunk[0];
+        }
+        offset += (chunk[0] + 3) & ~3u;
+    }
+
+    JsonValue document;
+    if (!json || !JsonParser((const char*)json, (const char*)json + jsonSize).parse(document))
+    {
+        std::cout << "Failed to parse the JSON chunk of " << path << std::endl;
+        return false;
+    }
+
+    // Embedded images, referenced by index from the meshes
+    const JsonValue* images = document.find("images");
+    if (images)
+    {
+        for (const JsonValue& image : images->items)
+        {
+            const JsonValue* view = document.at("bufferViews", image.indexOr("bufferView"));
+            size_t viewOffset = view ? (size_t)view->numberOr("byteOffset", 0) : 0;
+            size_t viewLength = view ? (size_t)view->numberOr("byteLength", 0) : 0;
+            if (view && bin && viewOffset <= binSize && viewLength <= binSize - viewOffset)
+                model.images.push_back({ bin + viewOffset, viewLength });
+            else
+                model.images.push_back({ nullptr, 0 });
+        }
+    }
+
+    // Roots of the default scene, or every node nobody claims as a child
+    std::vector<size_t> roots;
+    const JsonValue* scene = document.at("scenes", (size_t)document.numberOr("scene", 0));
+    const JsonValue* sceneNodes = scene ? scene->find("nodes") : nullptr;
+    if (sceneNodes)
+    {
+        for (const JsonValue& node : sceneNodes->items)
+            roots.push_back(node.asIndex());
+    }
+    else if (const JsonValue* nodes = document.find("nodes"))
+    {
+        std::vector<char> isChild(nodes->items.size(), 0);
+        for (const JsonValue& node : nodes->items)
+        {
+            if (const JsonValue* children = node.find("children"))
+            {
+                for (const JsonValue& child : children->items)
+                {
+                    if (child.asIndex() < isChild.size())
+                        isChild[child.asIndex()] = 1;
+                }
+            }
+        }
+        for (size_t i = 0; i < isChild.size(); i++)
+        {
+            if (!isChild[i])
+                roots.push_back(i);
+        }
+    }
+
+    std::string directory = ModelDirectory(path);
+    for (size_t root : roots)
+    {
+        if (!GltfImportNode(document, root, transform, bin, binSize, directory, model, 0))
+        {
+            std::cout << "Invalid node hierarchy in " << path << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif
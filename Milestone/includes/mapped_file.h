@@ -0,0 +1,125 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Read-only view of a whole file mapped into memory.
+ * Pages are faulted in on first touch, so only the parts actually read cost I/O.
+ */
+class MappedFile
+{
+public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char* path)
+    {
+        close();
+
+#ifdef _WIN32
+        mFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (mFile == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(mFile, &size) || size.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+        mSize = (size_t)size.QuadPart;
+
+        mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mMapping)
+        {
+            close();
+            return false;
+        }
+
+        mData = (const unsigned char*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+#else
+        mFile = ::open(path, O_RDONLY);
+        if (mFile < 0)
+            return false;
+
+        struct stat info;
+        if (fstat(mFile, &info) != 0 || info.st_size == 0)
+        {
+            close();
+            return false;
+        }
+        mSize = (size_t)info.st_size;
+
+        void* data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFile, 0);
+        mData = data == MAP_FAILED ? nullptr : (const unsigned char*)data;
+#endif
+
+        if (!mData)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (mData)
+            UnmapViewOfFile(mData);
+        if (mMapping)
+            CloseHandle(mMapping);
+        if (mFile != INVALID_HANDLE_VALUE)
+            CloseHandle(mFile);
+        mMapping = nullptr;
+        mFile = INVALID_HANDLE_VALUE;
+#else
+        if (mData)
+            munmap((void*)mData, mSize);
+        if (mFile >= 0)
+            ::close(mFile);
+        mFile = -1;
+#endif
+        mData = nullptr;
+        mSize = 0;
+    }
+
+    const unsigned char* data() const { return mData; }
+    size_t size() const { return mSize; }
+
+    // True when [offset, offset + length) lies inside the file
+    bool contains(unsigned long long offset, unsigned long long length) const
+    {
+        return offset <= mSize && length <= mSize - offset;
+    }
+
+private:
+    const unsigned char* mData = nullptr;
+    size_t mSize = 0;
+#ifdef _WIN32
+    HANDLE mFile = INVALID_HANDLE_VALUE;
+    HANDLE mMapping = nullptr;
+#else
+    int mFile = -1;
+#endif
+};
+
+#endif
@@ -0,0 +1,472 @@
+#ifndef MESHOPT_H
+#define MESHOPT_H
+
+#include <glm/glm.hpp>
+
+#include <vertex_format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+/* Index and vertex reordering for triangle lists in the full FLOATS_PER_VERTEX layout.
+ * OptimizeMesh runs the whole pipeline: weld exact duplicates, reorder triangles for the post-transform
+ * vertex cache, regroup them so outward facing clusters draw first, then renumber vertices in fetch order.
+ */
+
+const unsigned int VERTEX_CACHE_STATS_SIZE = 16; // FIFO size used to report ACMR and ATVR
+
+struct VertexCacheStats
+{
+    float acmr; // Average cache miss ratio, transformed vertices per triangle (0.5 ideal, 3 worst)
+    float atvr; // Average transformed vertex ratio, transformed vertices per unique vertex (1 ideal)
+};
+
+// Simulates a FIFO post-transform cache over a triangle list
+inline VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t nIndices, size_t nVertices, unsigned int cacheSize = VERTEX_CACHE_STATS_SIZE)
+{
+    VertexCacheStats stats = { 0.0f, 0.0f };
+    if (nIndices < 3 || nVertices == 0)
+        return stats;
+
+    std::vector<size_t> insertedAt(nVertices, 0); // Miss counter when the vertex entered the cache, 0 when never
+    std::vector<char> used(nVertices, 0);
+    size_t misses = 0;
+    size_t unique = 0;
+    for (size_t i = 0; i < nIndices; i++)
+    {
+        uint32_t v = indices[i];
+        if (!used[v])
+        {
+            used[v] = 1;
+            unique++;
+        }
+        if (insertedAt[v] == 0 || misses + 1 - insertedAt[v] > cacheSize)
+        {
+            misses++;
+            insertedAt[v] = misses;
+        }
+    }
+
+    stats.acmr = (float)misses / (nIndices / 3);
+    stats.atvr = (float)misses / unique;
+    return stats;
+}
+
+// Merges bit-identical vertices. Returns the new vertex count, the survivors keep their first-seen order.
+inline size_t WeldVertices(std::vector<float>& vertices, std::vector<uint32_t>& indices)
+{
+    struct Key
+    {
+        const float* vert;
+        bool operator==(const Key& other) const { return memcmp(vert, other.vert, sizeof(float) * FLOATS_PER_VERTEX) == 0; }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const
+        {
+            uint32_t words[FLOATS_PER_VERTEX];
+            memcpy(words, key.vert, sizeof(words));
+            uint64_t hash = 14695981039346656037ull;
+            for (uint32_t word : words)
+                hash = (hash ^ word) * 1099511628211ull;
+            return (size_t)hash;
+        }
+    };
+
+    size_t nVertices = vertices.size() / FLOATS_PER_VERTEX;
+    std::vector<uint32_t> remap(nVertices);
+    std::unordered_map<Key, uint32_t, KeyHash> unique;
+    unique.reserve(nVertices);
+    size_t nUnique = 0;
+    for (size_t v = 0; v < nVertices; v++)
+    {
+        auto inserted = unique.emplace(Key{ &vertices[v * FLOATS_PER_VERTEX] }, (uint32_t)nUnique);
+        if (inserted.second)
+            nUnique++;
+        remap[v] = inserted.first->second;
+    }
+    if (nUnique == nVertices)
+        return nVertices;
+
+    // Keys point into the buffer being compacted, so the map goes before the moves
+    unique.clear();
+    std::vector<char> placed(nUnique, 0);
+    for (size_t v = 0; v < nVertices; v++)
+    {
+        if (!placed[remap[v]])
+        {
+            placed[remap[v]] = 1;
+            memmove(&vertices[remap[v] * FLOATS_PER_VERTEX], &vertices[v * FLOATS_PER_VERTEX], sizeof(float) * FLOATS_PER_VERTEX);
+        }
+    }
+    vertices.resize(nUnique * FLOATS_PER_VERTEX);
+    for (uint32_t& index : indices)
+        index = remap[index];
+    return nUnique;
+}
+
+/* Tom Forsyth's linear-speed vertex cache optimisation.
+ * Greedily emits the triangle with the best score, where a vertex scores higher the more recently it was used
+ * and the fewer triangles it has left. Works for any cache size without knowing the hardware one.
+ */
+inline void OptimizeVertexCache(uint32_t* indices, size_t nIndices, size_t nVertices)
+{
+    const int cacheSize = 32;
+    const float cacheDecayPower = 1.5f;
+    const float lastTriangleScore = 0.75f;
+    const float valenceBoostScale = 2.0f;
+    const float valenceBoostPower = 0.5f;
+
+    size_t nTriangles = nIndices / 3;
+    if (nTriangles < 2)
+        return;
+
+    // Triangles of every vertex, as one flat list
+    std::vector<uint32_t> adjacencyOffset(nVertices + 1, 0);
+    for (size_t i = 0; i < nTriangles * 3; i++)
+        adjacencyOffset[indices[i] + 1]++;
+    for (size_t v = 0; v < nVertices; v++)
+        adjacencyOffset[v + 1] += adjacencyOffset[v];
+    std::vector<uint32_t> adjacency(nTriangles * 3);
+    std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t i = 0; i < nTriangles * 3; i++)
+        adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+
+    std::vector<uint32_t> remaining(nVertices);
+    for (size_t v = 0; v < nVertices; v++)
+        remaining[v] = adjacencyOffset[v + 1] - adjacencyOffset[v];
+    std::vector<int> cachePosition(nVertices, -1);
+
+    auto vertexScore = [&](uint32_t v)
+    {
+        if (remaining[v] == 0)
+            return -1.0f;
+
+        float score = 0.0f;
+        int position = cachePosition[v];
+        if (position >= 0)
+        {
+            if (position < 3)
+                score = lastTriangleScore; // Fixed score so the last triangle's vertices do not win by default
+            else
+                score = powf(1.0f - (float)(position - 3) / (cacheSize - 3), cacheDecayPower);
+        }
+        return score + valenceBoostScale * powf((float)remaining[v], -valenceBoostPower);
+    };
+
+    std::vector<float> vertexScores(nVertices);
+    for (size_t v = 0; v < nVertices; v++)
+        vertexScores[v] = vertexScore((uint32_t)v);
+
+    std::vector<float> triangleScores(nTriangles);
+    for (size_t t = 0; t < nTriangles; t++)
+        triangleScores[t] = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t + 1]] + vertexScores[indices[3 * t + 2]];
+
+    std::vector<char> emitted(nTriangles, 0);
+    std::vector<uint32_t> output;
+    output.reserve(nTriangles * 3);
+    std::vector<uint32_t> cache, nextCache, evicted;
+    cache.reserve(cacheSize + 3);
+    nextCache.reserve(cacheSize + 3);
+    evicted.reserve(3);
+    size_t scan = 0; // Fallback cursor, everything before it is already emitted
+
+    int best = -1;
+    float bestScore = -1.0f;
+    for (size_t t = 0; t < nTriangles; t++)
+    {
+        if (triangleScores[t] > bestScore)
+        {
+            bestScore = triangleScores[t];
+            best = (int)t;
+        }
+    }
+
+    while (output.size() < nTriangles * 3)
+    {
+        if (best < 0)
+        {
+            // Nothing in the cache touches a live triangle, restart from the next unemitted one
+            while (emitted[scan])
+                scan++;
+            best = (int)scan;
+        }
+
+        emitted[best] = 1;
+        const uint32_t* triangle = &indices[3 * best];
+        output.insert(output.end(), triangle, triangle + 3);
+
+        // The triangle's vertices move to the front of the LRU cache
+        nextCache.assign(triangle, triangle + 3);
+        for (uint32_t v : cache)
+        {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                nextCache.push_back(v);
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            uint32_t v = triangle[i];
+            uint32_t* begin = &adjacency[adjacencyOffset[v]];
+            uint32_t* end = begin + remaining[v];
+            *std::find(begin, end, (uint32_t)best) = end[-1];
+            remaining[v]--;
+        }
+        evicted.clear();
+        for (size_t i = cacheSize; i < nextCache.size(); i++)
+        {
+            cachePosition[nextCache[i]] = -1;
+            evicted.push_back(nextCache[i]);
+        }
+        if (nextCache.size() > (size_t)cacheSize)
+            nextCache.resize(cacheSize);
+        cache.swap(nextCache);
+
+        // Rescore the cached vertices, and the evicted ones that lost their cache score, with their triangles.
+        // The best triangle of a cached vertex goes next.
+        for (size_t i = 0; i < cache.size(); i++)
+            cachePosition[cache[i]] = (int)i;
+        best = -1;
+        bestScore = -1.0f;
+        auto rescore = [&](uint32_t v)
+        {
+            float delta = vertexScore(v) - vertexScores[v];
+            vertexScores[v] += delta;
+            for (uint32_t a = 0; a < remaining[v]; a++)
+            {
+                uint32_t t = adjacency[adjacencyOffset[v] + a];
+                triangleScores[t] += delta;
+            }
+        };
+        for (uint32_t v : cache)
+            rescore(v);
+        for (uint32_t v : evicted)
+            rescore(v);
+        for (uint32_t v : cache)
+        {
+            for (uint32_t a = 0; a < remaining[v]; a++)
+            {
+                uint32_t t = adjacency[adjacencyOffset[v] + a];
+                if (triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    best = (int)t;
+                }
+            }
+        }
+    }
+
+    memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+// Concatenates the clusters, those furthest out along their own normal first
+inline void SortClustersOutward(const uint32_t* indices, const float* vertices, const std::vector<size_t>& clusters,
+    const glm::vec3& meshCenter, std::vector<uint32_t>& output)
+{
+    size_t nClusters = clusters.size() - 1;
+    std::vector<float> sortKey(nClusters);
+    for (size_t c = 0; c < nClusters; c++)
+    {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+        {
+            const float* a = vertices + indices[3 * t] * FLOATS_PER_VERTEX;
+            const float* b = vertices + indices[3 * t + 1] * FLOATS_PER_VERTEX;
+            const float* d = vertices + indices[3 * t + 2] * FLOATS_PER_VERTEX;
+            glm::vec3 pa(a[0], a[1], a[2]), pb(b[0], b[1], b[2]), pd(d[0], d[1], d[2]);
+            glm::vec3 faceNormal = glm::cross(pb - pa, pd - pa);
+            float faceArea = glm::length(faceNormal);
+            centroid += (pa + pb + pd) * (faceArea / 3.0f);
+            normal += faceNormal;
+            area += faceArea;
+        }
+        float normalLength = glm::length(normal);
+        if (area > 0.0f && normalLength > 0.0f)
+            sortKey[c] = glm::dot(centroid / area - meshCenter, normal / normalLength);
+        else
+            sortKey[c] = 0.0f;
+    }
+
+    std::vector<size_t> order(nClusters);
+    for (size_t c = 0; c < nClusters; c++)
+        order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+    output.clear();
+    for (size_t c : order)
+        output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+}
+
+/* Reorders vertex cache optimised triangles so clusters facing away from the mesh center draw first,
+ * which lets early depth testing reject more of what is behind them. Clusters start wherever the cache
+ * order restarts and are split further only while the cluster's own ACMR stays within threshold of the
+ * whole cluster. Should the result still lose more than threshold of the cache efficiency, the hard clusters
+ * alone are tried, and failing that the order is left as it was.
+ */
+inline void OptimizeOverdraw(uint32_t* indices, size_t nIndices, const float* vertices, size_t nVertices, float threshold = 1.05f)
+{
+    size_t nTriangles = nIndices / 3;
+    if (nTriangles < 2)
+        return;
+
+    // Hard boundaries: triangles whose three vertices all miss the cache
+    std::vector<size_t> hard;
+    std::vector<size_t> insertedAt(nVertices, 0);
+    std::vector<uint32_t> missesPerTriangle(nTriangles);
+    size_t misses = 0;
+    for (size_t t = 0; t < nTriangles; t++)
+    {
+        uint32_t triangleMisses = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            uint32_t v = indices[3 * t + i];
+            if (insertedAt[v] == 0 || misses + 1 - insertedAt[v] > VERTEX_CACHE_STATS_SIZE)
+            {
+                misses++;
+                insertedAt[v] = misses;
+                triangleMisses++;
+            }
+        }
+        missesPerTriangle[t] = triangleMisses;
+        if (t == 0 || triangleMisses == 3)
+            hard.push_back(t);
+    }
+    hard.push_back(nTriangles);
+
+    // Soft boundaries inside each hard cluster
+    std::vector<size_t> soft;
+    for (size_t h = 0; h + 1 < hard.size(); h++)
+    {
+        size_t begin = hard[h], end = hard[h + 1];
+        size_t clusterMisses = 0;
+        for (size_t t = begin; t < end; t++)
+            clusterMisses += missesPerTriangle[t];
+        float clusterAcmr = (float)clusterMisses / (end - begin);
+
+        soft.push_back(begin);
+        size_t runMisses = 0;
+        size_t runStart = begin;
+        for (size_t t = begin; t < end; t++)
+        {
+            runMisses += missesPerTriangle[t];
+            size_t runLength = t + 1 - runStart;
+            if (t + 1 < end && runLength >= 8 && (float)runMisses / runLength <= clusterAcmr * threshold)
+            {
+                soft.push_back(t + 1);
+                runStart = t + 1;
+                runMisses = 0;
+            }
+        }
+    }
+    soft.push_back(nTriangles);
+
+    glm::vec3 meshCenter(0.0f);
+    for (size_t v = 0; v < nVertices; v++)
+        meshCenter += glm::vec3(vertices[v * FLOATS_PER_VERTEX], vertices[v * FLOATS_PER_VERTEX + 1], vertices[v * FLOATS_PER_VERTEX + 2]);
+    meshCenter /= (float)std::max<size_t>(nVertices, 1);
+
+    float inputAcmr = AnalyzeVertexCache(indices, nIndices, nVertices).acmr;
+    std::vector<uint32_t> output;
+    output.reserve(nTriangles * 3);
+    for (const std::vector<size_t>* clusters : { &soft, &hard })
+    {
+        SortClustersOutward(indices, vertices, *clusters, meshCenter, output);
+        if (AnalyzeVertexCache(output.data(), nIndices, nVertices).acmr <= inputAcmr * threshold)
+        {
+            memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+            return;
+        }
+    }
+}
+
+// Renumbers vertices in the order the indices first reference them and drops unreferenced ones. Returns the new count.
+inline size_t OptimizeVertexFetch(float* vertices, size_t nVertices, uint32_t* indices, size_t nIndices)
+{
+    const uint32_t unassigned = 0xffffffff;
+    std::vector<uint32_t> remap(nVertices, unassigned);
+    std::vector<float> fetched;
+    fetched.reserve(nVertices * FLOATS_PER_VERTEX);
+    for (size_t i = 0; i < nIndices; i++)
+    {
+        uint32_t& index = indices[i];
+        if (remap[index] == unassigned)
+        {
+            remap[index] = (uint32_t)(fetched.size() / FLOATS_PER_VERTEX);
+            fetched.insert(fetched.end(), vertices + index * FLOATS_PER_VERTEX, vertices + (index + 1) * FLOATS_PER_VERTEX);
+        }
+        index = remap[index];
+    }
+    memcpy(vertices, fetched.data(), fetched.size() * sizeof(float));
+    return fetched.size() / FLOATS_PER_VERTEX;
+}
+
+// Cache and overdraw ordering of the triangles alone, for index lists that share their vertices with others
+inline void OptimizeIndexOrder(const float* vertices, size_t nVertices, uint32_t* indices, size_t nIndices)
+{
+    // Authored strips can already beat the greedy order, those are kept
+    std::vector<uint32_t> authored(indices, indices + nIndices);
+    float authoredAcmr = AnalyzeVertexCache(indices, nIndices, nVertices).acmr;
+    OptimizeVertexCache(indices, nIndices, nVertices);
+    if (AnalyzeVertexCache(indices, nIndices, nVertices).acmr > authoredAcmr)
+        memcpy(indices, authored.data(), nIndices * sizeof(uint32_t));
+    OptimizeOverdraw(indices, nIndices, vertices, nVertices);
+}
+
+/* Cache, overdraw and fetch ordering in place. Returns the vertex count, which only shrinks when some
+ * vertices are not referenced at all.
+ */
+inline size_t OptimizeMeshOrder(float* vertices, size_t nVertices, uint32_t* indices, size_t nIndices)
+{
+    OptimizeIndexOrder(vertices, nVertices, indices, nIndices);
+    return OptimizeVertexFetch(vertices, nVertices, indices, nIndices);
+}
+
+// Runs the whole pipeline, welding included, and returns the cache statistics before and after
+inline void OptimizeMesh(std::vector<float>& vertices, std::vector<uint32_t>& indices, VertexCacheStats& before, VertexCacheStats& after)
+{
+    before = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size() / FLOATS_PER_VERTEX);
+
+    size_t nVertices = WeldVertices(vertices, indices);
+    nVertices = OptimizeMeshOrder(vertices.data(), nVertices, indices.data(), indices.size());
+    vertices.resize(nVertices * FLOATS_PER_VERTEX);
+
+    after = AnalyzeVertexCache(indices.data(), indices.size(), nVertices);
+}
+
+// Sums the statistics of meshes whose vertex count the optimisation kept, so they can be reported as one
+struct VertexCacheTotals
+{
+    double missesBefore = 0.0;
+    double missesAfter = 0.0;
+    size_t triangles = 0;
+    size_t vertices = 0;
+
+    void add(const VertexCacheStats& before, const VertexCacheStats& after, size_t nTriangles, size_t nVertices)
+    {
+        missesBefore += (double)before.acmr * nTriangles;
+        missesAfter += (double)after.acmr * nTriangles;
+        triangles += nTriangles;
+        vertices += nVertices;
+    }
+
+    VertexCacheStats before() const { return total(missesBefore); }
+    VertexCacheStats after() const { return total(missesAfter); }
+
+private:
+    VertexCacheStats total(double misses) const
+    {
+        VertexCacheStats stats = { 0.0f, 0.0f };
+        if (triangles && vertices)
+        {
+            stats.acmr = (float)(misses / triangles);
+            stats.atvr = (float)(misses / vertices);
+        }
+        return stats;
+    }
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+#include <glm/glm.hpp>
+
+#include <mapped_file.h>
+#include <vertex_format.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Output shared by the model importers.
+ * Vertices use the full FLOATS_PER_VERTEX layout and are already transformed into the scene.
+ */
+struct ImportedMesh
+{
+    std::vector<float> vertices;        // FLOATS_PER_VERTEX floats per vertex
+    std::vector<uint32_t> ownedIndices; // Indices the importer had to build or convert
+    const uint32_t* indices = nullptr;  // ownedIndices, or 32 bit indices read in place from the mapped file
+    size_t nIndices = 0;
+    std::string texture;                // Image file, empty when the texture is embedded or missing
+    int image = -1;                     // Embedded image in ImportedModel::images, -1 when none
+};
+
+struct ImportedImage // Encoded image bytes inside the mapped model file
+{
+    const unsigned char* data;
+    size_t size;
+};
+
+struct ImportedModel
+{
+    MappedFile file;                   // Keeps in-place indices and embedded images valid
+    std::vector<ImportedMesh> meshes;
+    std::vector<ImportedImage> images;
+};
+
+// Directory part of a path including its trailing separator, so relative references can be appended
+inline std::string ModelDirectory(const std::string& path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// Writes one full layout vertex, moving the position and normal into the scene
+inline void WriteModelVertex(float* vert, const glm::mat4& transform, const glm::mat3& normalMatrix,
+    const glm::vec3& position, const glm::vec3& normal, const glm::vec2& uv)
+{
+    glm::vec3 p = glm::vec3(transform * glm::vec4(position, 1.0f));
+    glm::vec3 n = normalMatrix * normal;
+    float length = glm::length(n);
+    if (length > 0.0f)
+        n /= length;
+
+    vert[0] = p.x;
+    vert[1] = p.y;
+    vert[2] = p.z;
+    vert[3] = n.x;
+    vert[4] = n.y;
+    vert[5] = n.z;
+    vert[6] = uv.x;
+    vert[7] = uv.y;
+}
+
+// Area weighted vertex normals for meshes that come without any
+inline void ComputeSmoothNormals(const float* positions, size_t nPositions, const uint32_t* indices, size_t nIndices, std::vector<glm::vec3>& normals)
+{
+    normals.assign(nPositions, glm::vec3(0.0f));
+    for (size_t i = 0; i + 2 < nIndices; i += 3)
+    {
+        uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a >= nPositions || b >= nPositions || c >= nPositions)
+            continue;
+
+        glm::vec3 pa(positions[3 * a], positions[3 * a + 1], positions[3 * a + 2]);
+        glm::vec3 pb(positions[3 * b], positions[3 * b + 1], positions[3 * b + 2]);
+        glm::vec3 pc(positions[3 * c], positions[3 * c + 1], positions[3 * c + 2]);
+        glm::vec3 faceNormal = glm::cross(pb - pa, pc - pa); // Length is twice the area
+        normals[a] += faceNormal;
+        normals[b] += faceNormal;
+        normals[c] += faceNormal;
+    }
+}
+
+#endif
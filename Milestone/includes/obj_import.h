@@ -0,0 +1,470 @@
+#ifndef OBJ_IMPORT_H
+#define OBJ_IMPORT_H
+
+#include <glm/glm.hpp>
+
+#include <model.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/* Wavefront OBJ importer.
+ * The file is mapped and split into newline aligned chunks that are tokenized on separate threads.
+ * A first pass counts the v/vt/vn statements of each chunk so the second pass knows where its attributes land
+ * and can resolve relative indices. Faces are fan triangulated and split into one mesh per material,
+ * and the v/vt/vn triplets are deduplicated into an indexed vertex list.
+ */
+
+const uint32_t OBJ_MISSING = 0xffffffff; // Corner without a texture coordinate or normal
+const size_t OBJ_MIN_CHUNK = 1 << 20;    // Smaller files are not worth splitting
+
+struct ObjCorner
+{
+    uint32_t position, uv, normal; // 0-based, OBJ_MISSING when absent
+
+    bool operator==(const ObjCorner& other) const
+    {
+        return position == other.position && uv == other.uv && normal == other.normal;
+    }
+};
+
+struct ObjCornerHash
+{
+    size_t operator()(const ObjCorner& corner) const
+    {
+        uint64_t hash = corner.position * 0x9e3779b97f4a7c15ull;
+        hash ^= (corner.uv + 0x7f4a7c15ull) * 0xbf58476d1ce4e5b9ull;
+        hash ^= (corner.normal + 0x1ce4e5b9ull) * 0x94d049bb133111ebull;
+        return (size_t)(hash ^ (hash >> 31));
+    }
+};
+
+struct ObjGroup // Consecutive triangles of one chunk that share a material
+{
+    std::string material;
+    std::vector<ObjCorner> corners; // Three per triangle
+};
+
+struct ObjChunk
+{
+    const char* begin;
+    const char* end;
+
+    // First pass
+    size_t nPositions = 0, nUvs = 0, nNormals = 0;
+    bool setsMaterial = false;
+    std::string lastMaterial;
+    std::string materialLibrary;
+
+    // Second pass
+    size_t basePositions = 0, baseUvs = 0, baseNormals = 0;
+    std::string startMaterial;
+    std::vector<ObjGroup> groups;
+    bool failed = false;
+};
+
+inline const char* ObjSkipSpace(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
+
+inline bool ObjParseFloat(const char*& p, const char* end, float& value)
+{
+    p = ObjSkipSpace(p, end);
+    if (p < end && *p == '+')
+        p++;
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc())
+        return false;
+    p = result.ptr;
+    return true;
+}
+
+inline bool ObjParseInt(const char*& p, const char* end, long long& value)
+{
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc())
+        return false;
+    p = result.ptr;
+    return true;
+}
+
+// Turns a 1-based or negative (relative) OBJ index into a 0-based one, given how many elements precede it
+inline bool ObjResolveIndex(long long index, size_t count, uint32_t& resolved)
+{
+    long long absolute = index > 0 ? index - 1 : (long long)count + index;
+    if (index == 0 || absolute < 0 || absolute >= (long long)count)
+        return false;
+    resolved = (uint32_t)absolute;
+    return true;
+}
+
+// Rest of the line after a keyword, without surrounding whitespace
+inline std::string ObjRestOfLine(const char* p, const char* end)
+{
+    p = ObjSkipSpace(p, end);
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+        end--;
+    return std::string(p, end);
+}
+
+// Calls visit(keyword, keywordLength, rest, lineEnd) for every non-empty line of [begin, end)
+template <typename Visit>
+inline void ObjForEachLine(const char* begin, const char* end, Visit visit)
+{
+    const char* line = begin;
+    while (line < end)
+    {
+        const char* lineEnd = (const char*)memchr(line, '\n', end - line);
+        if (!lineEnd)
+            lineEnd = end;
+
+        const char* keyword = ObjSkipSpace(line, lineEnd);
+        const char* rest = keyword;
+        while (rest < lineEnd && *rest != ' ' && *rest != '\t' && *rest != '\r')
+            rest++;
+        if (rest > keyword && *keyword != '#')
+            visit(keyword, (size_t)(rest - keyword), rest, lineEnd);
+
+        line = lineEnd + 1;
+    }
+}
+
+inline bool ObjKeyword(const char* keyword, size_t length, const char* expected)
+{
+    return length == strlen(expected) && memcmp(keyword, expected, length) == 0;
+}
+
+// Reads the diffuse map of every material in a .mtl file
+inline void ParseObjMaterials(const std::string& path, std::unordered_map<std::string, std::string>& textures)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cout << "Failed to open material library " << path << std::endl;
+        return;
+    }
+
+    std::string directory = ModelDirectory(path);
+    std::string material;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        const char* begin = line.data();
+        ObjForEachLine(begin, begin + line.size(), [&](const char* keyword, size_t length, const char* rest, const char* lineEnd)
+        {
+            if (ObjKeyword(keyword, length, "newmtl"))
+                material = ObjRestOfLine(rest, lineEnd);
+            else if (ObjKeyword(keyword, length, "map_Kd"))
+            {
+                // Options may precede the file name, which is always last
+                std::string value = ObjRestOfLine(rest, lineEnd);
+                size_t space = value.find_last_of(" \t");
+                textures[material] = directory + (space == std::string::npos ? value : value.substr(space + 1));
+            }
+        });
+    }
+}
+
+// Counts the attributes of a chunk and remembers its last material switch
+inline void ObjCountChunk(ObjChunk& chunk)
+{
+    ObjForEachLine(chunk.begin, chunk.end, [&](const char* keyword, size_t length, const char* rest, const char* lineEnd)
+    {
+        if (ObjKeyword(keyword, length, "v"))
+            chunk.nPositions++;
+        else if (ObjKeyword(keyword, length, "vt"))
+            chunk.nUvs++;
+        else if (ObjKeyword(keyword, length, "vn"))
+            chunk.nNormals++;
+        else if (ObjKeyword(keyword, length, "usemtl"))
+        {
+            chunk.setsMaterial = true;
+            chunk.lastMaterial = ObjRestOfLine(rest, lineEnd);
+        }
+        else if (ObjKeyword(keyword, length, "mtllib") && chunk.materialLibrary.empty())
+            chunk.materialLibrary = ObjRestOfLine(rest, lineEnd);
+    });
+}
+
+// Parses a chunk's attributes into their global slots and its faces into triangles
+inline void ObjParseChunk(ObjChunk& chunk, float* positions, float* uvs, float* normals)
+{
+    size_t nPositions = chunk.basePositions, nUvs = chunk.baseUvs, nNormals = chunk.baseNormals;
+    std::vector<ObjCorner> polygon;
+    chunk.groups.push_back({ chunk.startMaterial, {} });
+
+    ObjForEachLine(chunk.begin, chunk.end, [&](const char* keyword, size_t length, const char* rest, const char* lineEnd)
+    {
+        if (chunk.failed)
+            return;
+
+        const char* p = rest;
+        if (ObjKeyword(keyword, length, "v"))
+        {
+            float* position = positions + 3 * nPositions++;
+            chunk.failed = !ObjParseFloat(p, lineEnd, position[0]) || !ObjParseFloat(p, lineEnd, position[1]) || !ObjParseFloat(p, lineEnd, position[2]);
+        }
+        else if (ObjKeyword(keyword, length, "vt"))
+        {
+            float* uv = uvs + 2 * nUvs++;
+            chunk.failed = !ObjParseFloat(p, lineEnd, uv[0]);
+            if (!ObjParseFloat(p, lineEnd, uv[1]))
+                uv[1] = 0.0f;
+        }
+        else if (ObjKeyword(keyword, length, "vn"))
+        {
+            float* normal = normals + 3 * nNormals++;
+            chunk.failed = !ObjParseFloat(p, lineEnd, normal[0]) || !ObjParseFloat(p, lineEnd, normal[1]) || !ObjParseFloat(p, lineEnd, normal[2]);
+        }
+        else if (ObjKeyword(keyword, length, "usemtl"))
+        {
+            std::string material = ObjRestOfLine(rest, lineEnd);
+            if (chunk.groups.back().corners.empty())
+                chunk.groups.back().material = material;
+            else
+                chunk.groups.push_back({ material, {} });
+        }
+        else if (ObjKeyword(keyword, length, "f"))
+        {
+            polygon.clear();
+            while (true)
+            {
+                p = ObjSkipSpace(p, lineEnd);
+                if (p >= lineEnd || *p == '\r')
+                    break;
+
+                ObjCorner corner = { OBJ_MISSING, OBJ_MISSING, OBJ_MISSING };
+                long long index = 0;
+                if (!ObjParseInt(p, lineEnd, index) || !ObjResolveIndex(index, nPositions, corner.position))
+                {
+                    chunk.failed = true;
+                    return;
+                }
+                if (p < lineEnd && *p == '/')
+                {
+                    p++;
+                    if (p < lineEnd && *p != '/' && (!ObjParseInt(p, lineEnd, index) || !ObjResolveIndex(index, nUvs, corner.uv)))
+                    {
+                        chunk.failed = true;
+                        return;
+                    }
+                    if (p < lineEnd && *p == '/')
+                    {
+                        p++;
+                        if (!ObjParseInt(p, lineEnd, index) || !ObjResolveIndex(index, nNormals, corner.normal))
+                        {
+                            chunk.failed = true;
+                            return;
+                        }
+                    }
+                }
+                polygon.push_back(corner);
+            }
+
+            // Fan triangulation, polygons in OBJ files are convex
+            std::vector<ObjCorner>& corners = chunk.groups.back().corners;
+            for (size_t i = 2; i < polygon.size(); i++)
+            {
+                corners.push_back(polygon[0]);
+                corners.push_back(polygon[i - 1]);
+                corners.push_back(polygon[i]);
+            }
+        }
+    });
+}
+
+/* Imports an OBJ file, one mesh per material, with every vertex moved by transform.
+ * Returns false if the file cannot be read or references attributes it does not define.
+ */
+inline bool ImportObj(const char* path, const glm::mat4& transform, ImportedModel& model)
+{
+    if (!model.file.open(path))
+    {
+        std::cout << "Failed to open model " << path << std::endl;
+        return false;
+    }
+
+    // Newline aligned chunks, one per thread
+    const char* data = (const char*)model.file.data();
+    const char* dataEnd = data + model.file.size();
+    size_t nChunks = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), model.file.size() / OBJ_MIN_CHUNK));
+    std::vector<ObjChunk> chunks(nChunks);
+    const char* cursor = data;
+    for (size_t i = 0; i < nChunks; i++)
+    {
+        const char* end = dataEnd;
+        if (i + 1 < nChunks)
+        {
+            const char* split = std::max(cursor, data + model.file.size() * (i + 1) / nChunks);
+            const char* newline = (const char*)memchr(split, '\n', dataEnd - split);
+            end = newline ? newline + 1 : dataEnd;
+        }
+        chunks[i].begin = cursor;
+        chunks[i].end = end;
+        cursor = end;
+    }
+
+    auto runChunks = [&](auto work)
+    {
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < nChunks; i++)
+            workers.emplace_back(work, std::ref(chunks[i]));
+        work(chunks[0]);
+        for (std::thread& worker : workers)
+            worker.join();
+    };
+
+    runChunks([](ObjChunk& chunk) { ObjCountChunk(chunk); });
+
+    // Where each chunk's attributes go and which material is active when it starts
+    size_t nPositions = 0, nUvs = 0, nNormals = 0;
+    std::string material;
+    std::string materialLibrary;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.basePositions = nPositions;
+        chunk.baseUvs = nUvs;
+        chunk.baseNormals = nNormals;
+        chunk.startMaterial = material;
+        nPositions += chunk.nPositions;
+        nUvs += chunk.nUvs;
+        nNormals += chunk.nNormals;
+        if (chunk.setsMaterial)
+            material = chunk.lastMaterial;
+        if (materialLibrary.empty())
+            materialLibrary = chunk.materialLibrary;
+    }
+
+    std::vector<float> positions(3 * nPositions), uvs(2 * nUvs), normals(3 * nNormals);
+    runChunks([&](ObjChunk& chunk) { ObjParseChunk(chunk, positions.data(), uvs.data(), normals.data()); });
+
+    for (const ObjChunk& chunk : chunks)
+    {
+        if (chunk.failed)
+        {
+            std::cout << "Malformed statement or out of range index in " << path << std::endl;
+            return false;
+        }
+    }
+
+    std::unordered_map<std::string, std::string> materialTextures;
+    if (!materialLibrary.empty())
+        ParseObjMaterials(ModelDirectory(path) + materialLibrary, materialTextures);
+
+    // Gather the groups of each material, in order of first use
+    std::vector<std::string> materials;
+    std::vector<std::vector<const ObjGroup*>> materialGroups;
+    std::unordered_map<std::string, size_t> materialIndex;
+    bool needsNormals = false;
+    for (const ObjChunk& chunk : chunks)
+    {
+        for (const ObjGroup& group : chunk.groups)
+        {
+            if (group.corners.empty())
+                continue;
+
+            auto found = materialIndex.emplace(group.material, materials.size());
+            if (found.second)
+            {
+                materials.push_back(group.material);
+                materialGroups.emplace_back();
+            }
+            materialGroups[found.first->second].push_back(&group);
+
+            for (const ObjCorner& corner : group.corners)
+                needsNormals |= corner.normal == OBJ_MISSING;
+        }
+    }
+
+    // Corners without a normal share the smoothed normal of their position
+    std::vector<glm::vec3> smoothNormals;
+    if (needsNormals)
+    {
+        smoothNormals.assign(nPositions, glm::vec3(0.0f));
+        for (const std::vector<const ObjGroup*>& groups : materialGroups)
+        {
+            for (const ObjGroup* group : groups)
+            {
+                for (size_t i = 0; i + 2 < group->corners.size(); i += 3)
+                {
+                    const uint32_t a = group->corners[i].position, b = group->corners[i + 1].position, c = group->corners[i + 2].position;
+                    glm::vec3 pa(positions[3 * a], positions[3 * a + 1], positions[3 * a + 2]);
+                    glm::vec3 pb(positions[3 * b], positions[3 * b + 1], positions[3 * b + 2]);
+                    glm::vec3 pc(positions[3 * c], positions[3 * c + 1], positions[3 * c + 2]);
+                    glm::vec3 faceNormal = glm::cross(pb - pa, pc - pa);
+                    smoothNormals[a] += faceNormal;
+                    smoothNormals[b] += faceNormal;
+                    smoothNormals[c] += faceNormal;
+                }
+            }
+        }
+    }
+
+    // Each material is deduplicated into its own indexed mesh, materials in parallel
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+    model.meshes.resize(materials.size());
+    auto buildMesh = [&](size_t m)
+    {
+        ImportedMesh& mesh = model.meshes[m];
+        auto texture = materialTextures.find(materials[m]);
+        if (texture != materialTextures.end())
+            mesh.texture = texture->second;
+
+        size_t nCorners = 0;
+        for (const ObjGroup* group : materialGroups[m])
+            nCorners += group->corners.size();
+
+        std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> unique;
+        unique.reserve(nCorners / 2);
+        mesh.ownedIndices.reserve(nCorners);
+        for (const ObjGroup* group : materialGroups[m])
+        {
+            for (const ObjCorner& corner : group->corners)
+            {
+                auto inserted = unique.emplace(corner, (uint32_t)(mesh.vertices.size() / FLOATS_PER_VERTEX));
+                if (inserted.second)
+                {
+                    const float* p = &positions[3 * corner.position];
+                    glm::vec3 normal = corner.normal != OBJ_MISSING
+                        ? glm::vec3(normals[3 * corner.normal], normals[3 * corner.normal + 1], normals[3 * corner.normal + 2])
+                        : smoothNormals[corner.position];
+                    glm::vec2 uv = corner.uv != OBJ_MISSING ? glm::vec2(uvs[2 * corner.uv], uvs[2 * corner.uv + 1]) : glm::vec2(0.0f);
+
+                    mesh.vertices.resize(mesh.vertices.size() + FLOATS_PER_VERTEX);
+                    WriteModelVertex(&mesh.vertices[mesh.vertices.size() - FLOATS_PER_VERTEX], transform, normalMatrix, glm::vec3(p[0], p[1], p[2]), normal, uv);
+                }
+                mesh.ownedIndices.push_back(inserted.first->second);
+            }
+        }
+        mesh.indices = mesh.ownedIndices.data();
+        mesh.nIndices = mesh.ownedIndices.size();
+    };
+
+    std::vector<std::thread> workers;
+    size_t nThreads = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), materials.size()));
+    for (size_t t = 0; t < nThreads; t++)
+    {
+        workers.emplace_back([&, t]()
+        {
+            for (size_t m = t; m < materials.size(); m += nThreads)
+                buildMesh(m);
+        });
+    }
+    for (std::thread& worker : workers)
+        worker.join();
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,369 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define OCCLUSION_SSE
+#include <xmmintrin.h>
+#endif
+
+/* Software occlusion culling.
+ * Each frame a few large occluder boxes are rasterized, depth only, into a small buffer split into horizontal
+ * bands, one per worker thread, four pixels per SSE step. Every band then records the farthest depth of each
+ * of its tiles, and occludees are tested against those tiles first and their pixels only where a tile cannot
+ * decide. Depth is window z in [0, 1], nearer is smaller.
+ */
+
+const int OCCLUSION_WIDTH = 320;  // Depth buffer size, the window's aspect at a quarter of its height
+const int OCCLUSION_HEIGHT = 240;
+const int OCCLUSION_TILE = 8;     // Tile size of the hierarchical level, in pixels
+const int OCCLUSION_TILES_X = OCCLUSION_WIDTH / OCCLUSION_TILE;
+const int OCCLUSION_TILES_Y = OCCLUSION_HEIGHT / OCCLUSION_TILE;
+
+struct OcclusionStats
+{
+    size_t occluders = 0;       // Boxes drawn into the depth buffer
+    size_t triangles = 0;       // Their triangles left after near plane clipping
+    size_t tested = 0;          // Occludees tested
+    size_t occluded = 0;        // Draws saved
+    double fragments = 0.0;     // Window pixels covered by the saved draws' screen rectangles, an upper bound of the fragments saved
+};
+
+class OcclusionBuffer
+{
+public:
+    // Until start() the calling thread rasterizes the whole buffer as a single band
+    OcclusionBuffer()
+        : depth(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.0f), tileMax(OCCLUSION_TILES_X * OCCLUSION_TILES_Y, 1.0f), bandRows{ 0, OCCLUSION_HEIGHT }
+    {
+    }
+
+    // Splits the buffer into bands and starts their worker threads, once there are occluders to draw
+    void start()
+    {
+        if (!workers.empty())
+            return;
+
+        // Bands are whole tile rows, so each worker also finishes its own tiles
+        size_t nBands = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), OCCLUSION_TILES_Y));
+        bandRows.clear();
+        for (size_t band = 0; band < nBands; band++)
+            bandRows.push_back((int)(band * OCCLUSION_TILES_Y / nBands) * OCCLUSION_TILE);
+        bandRows.push_back(OCCLUSION_HEIGHT);
+
+        // The calling thread takes band 0
+        for (size_t band = 1; band < nBands; band++)
+            workers.emplace_back([this, band]() { work(band); });
+    }
+
+    ~OcclusionBuffer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    OcclusionBuffer(const OcclusionBuffer&) = delete;
+    OcclusionBuffer& operator=(const OcclusionBuffer&) = delete;
+
+    // Starts a frame seen through viewProjection, dropping the last frame's occluders
+    void begin(const glm::mat4& viewProjection)
+    {
+        this->viewProjection = viewProjection;
+        triangles.clear();
+        nOccluders = 0;
+    }
+
+    // Adds a solid box as an occluder. Only boxes the mesh fills completely may be added.
+    void addBox(const glm::vec3& boxMin, const glm::vec3& boxMax)
+    {
+        static const int faces[6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 } };
+        glm::vec4 corners[8];
+        for (int c = 0; c < 8; c++)
+        {
+            glm::vec3 corner((c & 1) ? boxMax.x : boxMin.x, (c & 2) ? boxMax.y : boxMin.y, (c & 4) ? boxMax.z : boxMin.z);
+            corners[c] = viewProjection * glm::vec4(corner, 1.0f);
+        }
+        for (const int* face : faces)
+        {
+            addTriangle(corners[face[0]], corners[face[1]], corners[face[2]]);
+            addTriangle(corners[face[0]], corners[face[2]], corners[face[3]]);
+        }
+        nOccluders++;
+    }
+
+    // Rasterizes the occluders on all the workers and builds the tile level
+    void rasterize()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            generation++;
+            pending = workers.size();
+        }
+        wake.notify_all();
+
+        rasterizeBand(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return pending == 0; });
+    }
+
+    /* Whether any part of a box may be in front of the occluders. windowArea receives the box's screen rectangle
+     * as a fraction of the window. Boxes reaching behind the near plane are always visible.
+     */
+    bool visible(const glm::vec3& boxMin, const glm::vec3& boxMax, float& windowArea) const
+    {
+        float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, nearest = FLT_MAX;
+        windowArea = 0.0f;
+        for (int c = 0; c < 8; c++)
+        {
+            glm::vec3 corner((c & 1) ? boxMax.x : boxMin.x, (c & 2) ? boxMax.y : boxMin.y, (c & 4) ? boxMax.z : boxMin.z);
+            glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+            if (clip.w <= OCCLUSION_NEAR_W || clip.z < -clip.w)
+                return true;
+
+            glm::vec3 window = toWindow(clip);
+            minX = std::min(minX, window.x);
+            maxX = std::max(maxX, window.x);
+            minY = std::min(minY, window.y);
+            maxY = std::max(maxY, window.y);
+            nearest = std::min(nearest, window.z);
+        }
+
+        // Grown by a pixel, so pixels the occluders only partly cover are never the last word
+        int x0 = std::max(0, (int)std::floor(minX) - 1), x1 = std::min(OCCLUSION_WIDTH - 1, (int)std::floor(maxX) + 1);
+        int y0 = std::max(0, (int)std::floor(minY) - 1), y1 = std::min(OCCLUSION_HEIGHT - 1, (int)std::floor(maxY) + 1);
+        if (x0 > x1 || y0 > y1)
+            return true;
+        windowArea = (std::min(maxX, (float)OCCLUSION_WIDTH) - std::max(minX, 0.0f)) * (std::min(maxY, (float)OCCLUSION_HEIGHT) - std::max(minY, 0.0f))
+                   / (OCCLUSION_WIDTH * OCCLUSION_HEIGHT);
+
+        for (int ty = y0 / OCCLUSION_TILE; ty <= y1 / OCCLUSION_TILE; ty++)
+        {
+            for (int tx = x0 / OCCLUSION_TILE; tx <= x1 / OCCLUSION_TILE; tx++)
+            {
+                if (tileMax[ty * OCCLUSION_TILES_X + tx] < nearest)
+                    continue;
+
+                // The tile has something behind the box somewhere, check the pixels the box covers
+                int px1 = std::min(x1, tx * OCCLUSION_TILE + OCCLUSION_TILE - 1), py1 = std::min(y1, ty * OCCLUSION_TILE + OCCLUSION_TILE - 1);
+                for (int y = std::max(y0, ty * OCCLUSION_TILE); y <= py1; y++)
+                {
+                    for (int x = std::max(x0, tx * OCCLUSION_TILE); x <= px1; x++)
+                    {
+                        if (depth[y * OCCLUSION_WIDTH + x] >= nearest)
+                            return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    size_t occluderCount() const { return nOccluders; }
+    size_t triangleCount() const { return triangles.size(); }
+
+private:
+    static constexpr float OCCLUSION_NEAR_W = 1e-5f; // Smallest w kept by near plane clipping
+
+    struct Triangle // Window space corners, x and y in pixels
+    {
+        glm::vec3 v[3];
+        float minY, maxY;
+    };
+
+    static glm::vec3 toWindow(const glm::vec4& clip)
+    {
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        return glm::vec3((ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH, (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT, ndc.z * 0.5f + 0.5f);
+    }
+
+    // Clips a clip space triangle against the near plane and keeps what is left in window space
+    void addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c)
+    {
+        const glm::vec4 in[3] = { a, b, c };
+        glm::vec4 clipped[4];
+        int nClipped = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            const glm::vec4& p = in[i];
+            const glm::vec4& q = in[(i + 1) % 3];
+            float dp = p.z + p.w, dq = q.z + q.w; // Distances to z = -w
+            if (dp >= 0.0f)
+                clipped[nClipped++] = p;
+            if ((dp >= 0.0f) != (dq >= 0.0f))
+                clipped[nClipped++] = p + (q - p) * (dp / (dp - dq));
+        }
+
+        for (int i = 2; i < nClipped; i++)
+        {
+            if (clipped[0].w <= OCCLUSION_NEAR_W || clipped[i - 1].w <= OCCLUSION_NEAR_W || clipped[i].w <= OCCLUSION_NEAR_W)
+                continue;
+            glm::vec3 v0 = toWindow(clipped[0]), v1 = toWindow(clipped[i - 1]), v2 = toWindow(clipped[i]);
+            Triangle triangle = { { v0, v1, v2 }, std::min(std::min(v0.y, v1.y), v2.y), std::max(std::max(v0.y, v1.y), v2.y) };
+            if (triangle.maxY >= 0.0f && triangle.minY < OCCLUSION_HEIGHT)
+                triangles.push_back(triangle);
+        }
+    }
+
+    void work(size_t band)
+    {
+        uint64_t seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return quit || generation != seen; });
+                if (quit)
+                    return;
+                seen = generation;
+            }
+
+            rasterizeBand(band);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending--;
+            }
+            done.notify_one();
+        }
+    }
+
+    // Clears the band, draws every triangle crossing it, then records its tiles' farthest depth
+    void rasterizeBand(size_t band)
+    {
+        int rowBegin = bandRows[band], rowEnd = bandRows[band + 1];
+        std::fill(depth.begin() + rowBegin * OCCLUSION_WIDTH, depth.begin() + rowEnd * OCCLUSION_WIDTH, 1.0f);
+
+        for (const Triangle& triangle : triangles)
+        {
+            if (triangle.maxY < rowBegin || triangle.minY >= rowEnd)
+                continue;
+            rasterizeTriangle(triangle, rowBegin, rowEnd);
+        }
+
+        for (int ty = rowBegin / OCCLUSION_TILE; ty < rowEnd / OCCLUSION_TILE; ty++)
+        {
+            for (int tx = 0; tx < OCCLUSION_TILES_X; tx++)
+            {
+                float farthest = 0.0f;
+                for (int y = ty * OCCLUSION_TILE; y < (ty + 1) * OCCLUSION_TILE; y++)
+                {
+                    const float* row = &depth[y * OCCLUSION_WIDTH + tx * OCCLUSION_TILE];
+                    for (int x = 0; x < OCCLUSION_TILE; x++)
+                        farthest = std::max(farthest, row[x]);
+                }
+                tileMax[ty * OCCLUSION_TILES_X + tx] = farthest;
+            }
+        }
+    }
+
+    // Half space rasterization at pixel centers, keeping the nearest depth
+    void rasterizeTriangle(const Triangle& triangle, int rowBegin, int rowEnd)
+    {
+        glm::vec3 v0 = triangle.v[0], v1 = triangle.v[1], v2 = triangle.v[2];
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (std::fabs(area) < 1e-8f)
+            return;
+        if (area < 0.0f) // Both windings occlude, make every triangle counterclockwise
+        {
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        int x0 = std::max(0, (int)std::floor(std::min(std::min(v0.x, v1.x), v2.x)));
+        int x1 = std::min(OCCLUSION_WIDTH - 1, (int)std::ceil(std::max(std::max(v0.x, v1.x), v2.x)));
+        int y0 = std::max(rowBegin, (int)std::floor(triangle.minY));
+        int y1 = std::min(rowEnd - 1, (int)std::ceil(triangle.maxY));
+        if (x0 > x1 || y0 > y1)
+            return;
+
+        // Edge i is positive on the inside: e = a * x + b * y + c
+        const glm::vec3* corners[3] = { &v0, &v1, &v2 };
+        float a[3], b[3], c[3];
+        for (int i = 0; i < 3; i++)
+        {
+            const glm::vec3& p = *corners[i];
+            const glm::vec3& q = *corners[(i + 1) % 3];
+            a[i] = p.y - q.y;
+            b[i] = q.x - p.x;
+            c[i] = p.x * q.y - p.y * q.x;
+        }
+
+        // Depth is linear in window space
+        float dzdx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+        float dzdy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+        float z0 = v0.z - dzdx * v0.x - dzdy * v0.y;
+
+        x0 &= ~3; // Whole SSE steps, the buffer width is a multiple of four
+        for (int y = y0; y <= y1; y++)
+        {
+            float py = y + 0.5f;
+            float* row = &depth[y * OCCLUSION_WIDTH];
+#ifdef OCCLUSION_SSE
+            const __m128 steps = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+            const __m128 zero = _mm_setzero_ps();
+            __m128 rowEdge[3], edgeA[3];
+            for (int i = 0; i < 3; i++)
+            {
+                rowEdge[i] = _mm_set1_ps(b[i] * py + c[i]);
+                edgeA[i] = _mm_set1_ps(a[i]);
+            }
+            __m128 rowDepth = _mm_set1_ps(z0 + dzdy * py), slope = _mm_set1_ps(dzdx);
+            for (int x = x0; x <= x1; x += 4)
+            {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), steps);
+                __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], px), rowEdge[0]), zero);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], px), rowEdge[1]), zero));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], px), rowEdge[2]), zero));
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+
+                __m128 z = _mm_add_ps(rowDepth, _mm_mul_ps(slope, px));
+                __m128 stored = _mm_loadu_ps(row + x);
+                __m128 nearer = _mm_min_ps(stored, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, stored)));
+            }
+#else
+            for (int x = x0; x <= x1; x++)
+            {
+                float px = x + 0.5f;
+                if (a[0] * px + b[0] * py + c[0] < 0.0f || a[1] * px + b[1] * py + c[1] < 0.0f || a[2] * px + b[2] * py + c[2] < 0.0f)
+                    continue;
+                row[x] = std::min(row[x], z0 + dzdx * px + dzdy * py);
+            }
+#endif
+        }
+    }
+
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    std::vector<Triangle> triangles;
+    size_t nOccluders = 0;
+    std::vector<float> depth;   // OCCLUSION_WIDTH * OCCLUSION_HEIGHT, row 0 at the bottom like the window
+    std::vector<float> tileMax; // Farthest depth of each tile
+    std::vector<int> bandRows;  // First row of each band, then the buffer height
+
+    std::vector<std::thread> workers; // One per band after the first
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    uint64_t generation = 0;
+    size_t pending = 0;
+    bool quit = false;
+};
+
+#endif
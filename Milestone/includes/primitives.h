@@ -0,0 +1,386 @@
+#ifndef PRIMITIVES_H
+#define PRIMITIVES_H
+
+#include <vertex_format.h>
+
+#include <array>
+#include <cmath>
+
+/* Procedural primitive generators.
+ * Each generator writes FLOATS_PER_VERTEX floats per vertex and indices relative to its first vertex
+ * into buffers the caller has already sized with the matching *Count functions. They never allocate.
+ * Unit shapes are constexpr tables, so at runtime a primitive is only a scale and a move of baked data.
+ */
+
+const float PRIMITIVE_PI = 3.14159265358979f;
+
+// Box corners as signs of the half extents, followed by the normal and texture coordinate
+constexpr float BOX_TABLE[] = {
+     1.0f,  1.0f,  1.0f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
+     1.0f, -1.0f,  1.0f,  0.0f,  0.0f, -1.0f,  1.0f,  0.0f,
+    -1.0f,  1.0f,  1.0f,  0.0f,  0.0f, -1.0f,  0.0f,  1.0f,
+
+     1.0f, -1.0f,  1.0f,  0.0f,  0.0f, -1.0f,  1.0f,  0.0f,
+    -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
+    -1.0f,  1.0f,  1.0f,  0.0f,  0.0f, -1.0f,  0.0f,  1.0f,
+
+     1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
+     1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+     1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
+
+     1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
+     1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
+     1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+
+     1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f,  1.0f,  1.0f,
+     1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
+    -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f,  0.0f,  0.0f,
+
+     1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f,  1.0f,  1.0f,
+    -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f,
+    -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f,  0.0f,  0.0f,
+
+     1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  1.0f,  0.0f,
+     1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
+    -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  0.0f,  1.0f,
+
+     1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  1.0f,  0.0f,
+    -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  0.0f,  1.0f,
+    -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
+
+    -1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+    -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
+    -1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+
+    -1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+    -1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+    -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
+
+     1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f,  1.0f,  1.0f,
+     1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
+    -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f,  0.0f,  0.0f,
+
+     1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f,  1.0f,  1.0f,
+    -1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
+    -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f,  0.0f,  0.0f,
+};
+constexpr unsigned int BOX_VERTEX_COUNT = sizeof(BOX_TABLE) / (sizeof(BOX_TABLE[0]) * FLOATS_PER_VERTEX);
+
+// Square pyramid corners as signs of the half extents (the apex sits at the center top)
+constexpr float PYRAMID_TABLE[] = {
+    -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
+     0.0f,  1.0f,  0.0f,  0.0f,  0.0f, -1.0f,  0.5f,  1.0f,
+     1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  1.0f,  0.0f,
+
+    -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
+     0.0f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,  0.5f,  1.0f,
+     1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f,  0.0f,
+
+    -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
+     0.0f,  1.0f,  0.0f, -1.0f,  0.0f,  0.0f,  0.5f,  1.0f,
+    -1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+
+     1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
+     0.0f,  1.0f,  0.0f,  1.0f,  0.0f,  0.0f,  0.5f,  1.0f,
+     1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+
+    -1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
+     1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+    -1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+
+    -1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+     1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
+     1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+};
+constexpr unsigned int PYRAMID_VERTEX_COUNT = sizeof(PYRAMID_TABLE) / (sizeof(PYRAMID_TABLE[0]) * FLOATS_PER_VERTEX);
+
+// Plane corners picked per vertex (1 and 3 are opposite), followed by the normal and texture coordinate
+constexpr float PLANE_TABLE[] = {
+    0.0f,  1.0f, 0.0f, 0.0f,  0.0f, 0.0f,
+    1.0f,  1.0f, 0.0f, 0.0f,  0.0f, 1.0f,
+    2.0f,  1.0f, 0.0f, 0.0f,  1.0f, 1.0f,
+    0.0f,  1.0f, 0.0f, 0.0f,  0.0f, 0.0f,
+    3.0f,  1.0f, 0.0f, 0.0f,  1.0f, 0.0f,
+    2.0f,  1.0f, 0.0f, 0.0f,  1.0f, 1.0f,
+};
+constexpr unsigned int PLANE_VERTEX_COUNT = sizeof(PLANE_TABLE) / (sizeof(PLANE_TABLE[0]) * 6);
+
+/* Writes a table's vertices scaled by (sx, sy, sz) and moved to (x, y, z).
+ * The loop is branch free and straight line so the compiler can vectorize it.
+ */
+inline void TransformTable(const float* table, unsigned int nVertices, float x, float y, float z, float sx, float sy, float sz, float* vertices)
+{
+    for (unsigned int i = 0; i < nVertices; i++)
+    {
+        const float* in = table + i * FLOATS_PER_VERTEX;
+        float* out = vertices + i * FLOATS_PER_VERTEX;
+        out[0] = x + in[0] * sx;
+        out[1] = y + in[1] * sy;
+        out[2] = z + in[2] * sz;
+        out[3] = in[3];
+        out[4] = in[4];
+        out[5] = in[5];
+        out[6] = in[6];
+        out[7] = in[7];
+    }
+}
+
+// Writes a triangle list table, each vertex indexed once in order
+inline void GenerateFromTable(const float* table, unsigned int nVertices, float x, float y, float z, float sx, float sy, float sz, float* vertices, unsigned int* indices)
+{
+    TransformTable(table, nVertices, x, y, z, sx, sy, sz, vertices);
+    for (unsigned int i = 0; i < nVertices; i++)
+        indices[i] = i;
+}
+
+// Writes a box centered at (x, y, z) with half extents w, h, l (BOX_VERTEX_COUNT vertices and indices)
+inline void GenerateBox(float x, float y, float z, float w, float h, float l, float* vertices, unsigned int* indices)
+{
+    GenerateFromTable(BOX_TABLE, BOX_VERTEX_COUNT, x, y, z, w, h, l, vertices, indices);
+}
+
+// Writes a square pyramid whose base center is (x, y - h, z) (PYRAMID_VERTEX_COUNT vertices and indices)
+inline void GeneratePyramid(float x, float y, float z, float w, float h, float l, float* vertices, unsigned int* indices)
+{
+    GenerateFromTable(PYRAMID_TABLE, PYRAMID_VERTEX_COUNT, x, y, z, w, h, l, vertices, indices);
+}
+
+// Writes a quad from four corners, 1 and 3 being opposite (PLANE_VERTEX_COUNT vertices and indices)
+inline void GeneratePlane(const glm::vec3 corners[4], float* vertices, unsigned int* indices)
+{
+    for (unsigned int i = 0; i < PLANE_VERTEX_COUNT; i++)
+    {
+        const float* in = PLANE_TABLE + i * 6;
+        const glm::vec3& corner = corners[(int)in[0]];
+        float* out = vertices + i * FLOATS_PER_VERTEX;
+        out[0] = corner.x;
+        out[1] = corner.y;
+        out[2] = corner.z;
+        out[3] = in[1];
+        out[4] = in[2];
+        out[5] = in[3];
+        out[6] = in[4];
+        out[7] = in[5];
+        indices[i] = i;
+    }
+}
+
+// Vertices written by GenerateCylinder
+constexpr unsigned int CylinderVertexCount(unsigned int edges, bool capped)
+{
+    // The seam column is duplicated so the texture wraps once; each cap is a center plus a ring
+    return 2 * (edges + 1) + (capped ? 2 * (edges + 1) : 0);
+}
+
+// Indices written by GenerateCylinder
+constexpr unsigned int CylinderIndexCount(unsigned int edges, bool capped)
+{
+    return 6 * edges + (capped ? 6 * edges : 0);
+}
+
+// Largest distance between the true surface and a cylinder tessellated with this many edges
+inline float CylinderTessellationError(float r, unsigned int edges)
+{
+    return r * (1.0f - cosf(PRIMITIVE_PI / edges));
+}
+
+// Sine usable in constant expressions: range reduced to [-pi, pi], then a Taylor series
+constexpr double ConstexprSin(double x)
+{
+    const double pi = 3.14159265358979323846;
+    while (x > pi)
+        x -= 2 * pi;
+    while (x < -pi)
+        x += 2 * pi;
+
+    double term = x;
+    double sum = x;
+    for (int n = 1; n < 12; n++)
+    {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double ConstexprCos(double x)
+{
+    return ConstexprSin(x + 3.14159265358979323846 / 2);
+}
+
+// Trigonometry for WriteCylinder, one for compile time tables and one for runtime generation
+struct ConstexprTrig
+{
+    constexpr void operator()(unsigned int i, unsigned int edges, float& s, float& c) const
+    {
+        double angle = 2 * 3.14159265358979323846 * i / edges;
+        s = (float)ConstexprSin(angle);
+        c = (float)ConstexprCos(angle);
+    }
+};
+
+struct RuntimeTrig
+{
+    void operator()(unsigned int i, unsigned int edges, float& s, float& c) const
+    {
+        s = sinf(2 * PRIMITIVE_PI * i / edges);
+        c = cosf(2 * PRIMITIVE_PI * i / edges);
+    }
+};
+
+/* Writes a cylinder around the y axis centered at (x, y, z) with smooth side normals.
+ * Capped cylinders get flat top and bottom discs with planar texture mapping.
+ * The sine and cosine ring is evaluated once per column; the caps read it back from the side normals.
+ */
+template <typename Trig>
+constexpr void WriteCylinder(float x, float y, float z, float r, float h, unsigned int edges, bool capped, float* vertices, unsigned int* indices, Trig trig)
+{
+    float* vert = vertices;
+    unsigned int* index = indices;
+    const float top = y + h / 2;
+    const float bottom = y - h / 2;
+
+    // Side: a top and bottom vertex per column, the normal points straight out from the axis
+    for (unsigned int i = 0; i <= edges; i++)
+    {
+        float u = (float)i / edges;
+        float s = 0.0f;
+        float c = 0.0f;
+        trig(i % edges, edges, s, c);
+
+        const float column[] = {
+            x + r * s, top,    z + r * c, s, 0.0f, c, u, 1.0f,
+            x + r * s, bottom, z + r * c, s, 0.0f, c, u, 0.0f,
+        };
+        for (float value : column)
+            *vert++ = value;
+    }
+
+    // Two counter-clockwise triangles per column seen from outside
+    for (unsigned int i = 0; i < edges; i++)
+    {
+        unsigned int topLeft = 2 * i;
+        unsigned int bottomLeft = topLeft + 1;
+        unsigned int topRight = topLeft + 2;
+        unsigned int bottomRight = topLeft + 3;
+        const unsigned int quad[] = { bottomLeft, bottomRight, topLeft, topLeft, bottomRight, topRight };
+        for (unsigned int value : quad)
+            *index++ = value;
+    }
+
+    if (!capped)
+        return;
+
+    // Caps: a center vertex followed by the ring, facing up for the top and down for the bottom
+    for (int cap = 0; cap < 2; cap++)
+    {
+        unsigned int center = (unsigned int)((vert - vertices) / FLOATS_PER_VERTEX);
+        float capY = cap == 0 ? top : bottom;
+        float ny = cap == 0 ? 1.0f : -1.0f;
+
+        const float middle[] = { x, capY, z, 0.0f, ny, 0.0f, 0.5f, 0.5f };
+        for (float value : middle)
+            *vert++ = value;
+
+        for (unsigned int i = 0; i < edges; i++)
+        {
+            const float* column = vertices + 2 * i * FLOATS_PER_VERTEX;
+            float s = column[3];
+            float c = column[5];
+            const float ring[] = { x + r * s, capY, z + r * c, 0.0f, ny, 0.0f, 0.5f + 0.5f * s, 0.5f + 0.5f * c };
+            for (float value : ring)
+                *vert++ = value;
+        }
+
+        for (unsigned int i = 0; i < edges; i++)
+        {
+            unsigned int current = center + 1 + i;
+            unsigned int next = center + 1 + (i + 1) % edges;
+            *index++ = center;
+            *index++ = cap == 0 ? current : next;
+            *index++ = cap == 0 ? next : current;
+        }
+    }
+}
+
+/* Unit cylinder (radius 1, height 1, centered on the origin) evaluated entirely at compile time.
+ * The tables land in read-only data; GenerateCylinder only scales and moves them.
+ */
+template <unsigned int Edges, bool Capped>
+struct Cylinder
+{
+    static constexpr unsigned int nVertices = CylinderVertexCount(Edges, Capped);
+    static constexpr unsigned int nIndices = CylinderIndexCount(Edges, Capped);
+
+    struct Tables
+    {
+        std::array<float, nVertices * FLOATS_PER_VERTEX> vertices;
+        std::array<unsigned int, nIndices> indices;
+    };
+
+    static constexpr Tables build()
+    {
+        Tables tables = {};
+        WriteCylinder(0.0f, 0.0f, 0.0f, 1.0f, 1.0f, Edges, Capped, tables.vertices.data(), tables.indices.data(), ConstexprTrig());
+        return tables;
+    }
+
+    static constexpr Tables tables = build();
+};
+
+// The first side column sits on +z, half a unit up, and wraps the texture from u = 0
+static_assert(Cylinder<4, false>::tables.vertices[2] == 1.0f && Cylinder<4, false>::tables.vertices[1] == 0.5f,
+    "constexpr cylinder tables are out of step with WriteCylinder");
+
+struct BakedCylinder // Type-erased view of one Cylinder<Edges, Capped> specialization
+{
+    unsigned int edges;
+    bool capped;
+    const float* vertices;
+    unsigned int nVertices;
+    const unsigned int* indices;
+    unsigned int nIndices;
+};
+
+template <unsigned int Edges, bool Capped>
+constexpr BakedCylinder Bake()
+{
+    return { Edges, Capped, Cylinder<Edges, Capped>::tables.vertices.data(), Cylinder<Edges, Capped>::nVertices,
+             Cylinder<Edges, Capped>::tables.indices.data(), Cylinder<Edges, Capped>::nIndices };
+}
+
+// Edge counts reached by the default LOD chains (each level halves the edges) plus a few common ones
+constexpr BakedCylinder BAKED_CYLINDERS[] = {
+    Bake<3, true>(), Bake<4, true>(), Bake<6, true>(), Bake<8, true>(), Bake<12, true>(),
+    Bake<16, true>(), Bake<24, true>(), Bake<32, true>(), Bake<48, true>(), Bake<64, true>(),
+    Bake<3, false>(), Bake<4, false>(), Bake<6, false>(), Bake<8, false>(), Bake<12, false>(),
+    Bake<16, false>(), Bake<24, false>(), Bake<32, false>(), Bake<48, false>(), Bake<64, false>(),
+};
+
+// Writes a table's vertices scaled by (sx, sy, sz) and moved to (x, y, z), and copies its indices
+inline void GenerateFromIndexedTable(const float* table, unsigned int nVertices, const unsigned int* tableIndices, unsigned int nIndices,
+    float x, float y, float z, float sx, float sy, float sz, float* vertices, unsigned int* indices)
+{
+    TransformTable(table, nVertices, x, y, z, sx, sy, sz, vertices);
+    for (unsigned int i = 0; i < nIndices; i++)
+        indices[i] = tableIndices[i];
+}
+
+/* Writes a cylinder around the y axis centered at (x, y, z).
+ * Baked edge counts only transform their compile time table; any other count is generated on the spot.
+ */
+inline void GenerateCylinder(float x, float y, float z, float r, float h, unsigned int edges, bool capped, float* vertices, unsigned int* indices)
+{
+    for (const BakedCylinder& baked : BAKED_CYLINDERS)
+    {
+        if (baked.edges == edges && baked.capped == capped)
+        {
+            GenerateFromIndexedTable(baked.vertices, baked.nVertices, baked.indices, baked.nIndices, x, y, z, r, h, r, vertices, indices);
+            return;
+        }
+    }
+
+    WriteCylinder(x, y, z, r, h, edges, capped, vertices, indices, RuntimeTrig());
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <archive.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+/* Linked program binaries kept on disk between runs, one file per program.
+ *
+ *   ProgramCacheHeader
+ *   binary             length bytes, as glGetProgramBinary returned them
+ *
+ * A file is named after its program's key, a hash of the shader sources and of the driver that produced the
+ * binary, so an edited shader or an updated driver misses and compiles from source again.
+ */
+
+const char PROGRAM_CACHE_MAGIC[8] = { 'M', 'S', 'P', 'R', 'O', 'G', '\0', '\0' };
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t format;    // Binary format the driver reported with the binary
+    uint64_t key;       // Repeats the file name, so a renamed file is not loaded for another program
+    uint64_t length;
+};
+static_assert(sizeof(ProgramCacheHeader) % 8 == 0, "the binary must start 8 byte aligned");
+
+// Chains a string into a program key, its length first so neighbouring strings cannot run together
+inline uint64_t ProgramCacheHash(const char* text, uint64_t seed)
+{
+    uint64_t length = text ? std::strlen(text) : 0;
+    return HashBytes(text, (size_t)length, HashBytes(&length, sizeof(length), seed));
+}
+
+inline std::string ProgramCachePath(const char* directory, uint64_t key)
+{
+    char name[24];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return std::string(directory) + "/" + name;
+}
+
+// Whether size bytes hold a complete entry for key
+inline bool ProgramCacheValid(const unsigned char* data, size_t size, uint64_t key)
+{
+    if (size < sizeof(ProgramCacheHeader))
+        return false;
+    ProgramCacheHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    return std::memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) == 0
+        && header.version == PROGRAM_CACHE_VERSION
+        && header.key == key
+        && header.length > 0
+        && header.length == size - sizeof(header);
+}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/* Draw ordering by 64 bit sort keys.
+ * Each draw gets a key holding, from the most significant bits down, its program, vertex array, material and
+ * quantized depth, so sorting the keys groups draws by the state that costs most to change and orders each group
+ * front to back for early depth rejection. Keys are sorted by a least significant digit radix sort, linear in the
+ * number of draws, which skips the digits every key shares.
+ */
+
+const int RENDER_KEY_PROGRAM_BITS = 12;
+const int RENDER_KEY_VAO_BITS = 12;
+const int RENDER_KEY_MATERIAL_BITS = 16;
+const int RENDER_KEY_DEPTH_BITS = 24;
+const int RENDER_QUEUE_DIGIT_BITS = 8;
+const int RENDER_QUEUE_DIGITS = 64 / RENDER_QUEUE_DIGIT_BITS;
+const size_t RENDER_QUEUE_BUCKETS = size_t(1) << RENDER_QUEUE_DIGIT_BITS;
+
+/* Quantizes a non-negative view distance so nearer is smaller. The bit pattern of a non-negative float grows with its
+ * value, so its top bits keep the order over any range without a near and far plane to scale by.
+ */
+inline uint32_t RenderKeyDepth(float distance)
+{
+    if (!(distance > 0.0f))
+        return 0;
+    uint32_t bits;
+    std::memcpy(&bits, &distance, sizeof(bits));
+    return bits >> (32 - RENDER_KEY_DEPTH_BITS);
+}
+
+// Builds a key from ids already mapped into their fields' ranges, larger ids are masked
+inline uint64_t RenderKey(uint32_t program, uint32_t vao, uint32_t material, uint32_t depth)
+{
+    const uint64_t programMask = (uint64_t(1) << RENDER_KEY_PROGRAM_BITS) - 1;
+    const uint64_t vaoMask = (uint64_t(1) << RENDER_KEY_VAO_BITS) - 1;
+    const uint64_t materialMask = (uint64_t(1) << RENDER_KEY_MATERIAL_BITS) - 1;
+    const uint64_t depthMask = (uint64_t(1) << RENDER_KEY_DEPTH_BITS) - 1;
+    return ((program & programMask) << (RENDER_KEY_VAO_BITS + RENDER_KEY_MATERIAL_BITS + RENDER_KEY_DEPTH_BITS))
+        | ((vao & vaoMask) << (RENDER_KEY_MATERIAL_BITS + RENDER_KEY_DEPTH_BITS))
+        | ((material & materialMask) << RENDER_KEY_DEPTH_BITS)
+        | (depth & depthMask);
+}
+
+inline uint32_t RenderKeyMaterial(uint64_t key)
+{
+    return (uint32_t)((key >> RENDER_KEY_DEPTH_BITS) & ((uint64_t(1) << RENDER_KEY_MATERIAL_BITS) - 1));
+}
+
+/* Keys with a 32 bit payload each, usually the index of the draw they belong to. The buffers are kept between frames,
+ * so a steady scene sorts without allocating.
+ */
+class RenderQueue
+{
+public:
+    void clear()
+    {
+        keys.clear();
+        values.clear();
+    }
+
+    void reserve(size_t n)
+    {
+        keys.reserve(n);
+        values.reserve(n);
+    }
+
+    void push(uint64_t key, uint32_t value)
+    {
+        keys.push_back(key);
+        values.push_back(value);
+    }
+
+    size_t size() const { return keys.size(); }
+    uint64_t key(size_t i) const { return keys[i]; }
+    uint32_t value(size_t i) const { return values[i]; }
+
+    // Stable sort by key, so draws with equal keys keep the order they were pushed in
+    void sort()
+    {
+        size_t n = keys.size();
+        if (n < 2)
+            return;
+
+        // Every digit's histogram in one read of the keys
+        histograms.assign(RENDER_QUEUE_DIGITS * RENDER_QUEUE_BUCKETS, 0);
+        uint32_t* counts = histograms.data();
+        for (size_t i = 0; i < n; i++)
+        {
+            uint64_t key = keys[i];
+            for (int d = 0; d < RENDER_QUEUE_DIGITS; d++)
+                counts[d * RENDER_QUEUE_BUCKETS + ((key >> (d * RENDER_QUEUE_DIGIT_BITS)) & (RENDER_QUEUE_BUCKETS - 1))]++;
+        }
+
+        scratchKeys.resize(n);
+        scratchValues.resize(n);
+        for (int d = 0; d < RENDER_QUEUE_DIGITS; d++)
+        {
+            uint32_t* count = counts + d * RENDER_QUEUE_BUCKETS;
+            int shift = d * RENDER_QUEUE_DIGIT_BITS;
+
+            // A digit all keys share would only copy them, program and VAO digits usually are
+            if (count[(keys[0] >> shift) & (RENDER_QUEUE_BUCKETS - 1)] == n)
+                continue;
+
+            uint32_t offset = 0;
+            for (size_t b = 0; b < RENDER_QUEUE_BUCKETS; b++)
+            {
+                uint32_t c = count[b];
+                count[b] = offset;
+                offset += c;
+            }
+            const uint64_t* fromKeys = keys.data();
+            const uint32_t* fromValues = values.data();
+            uint64_t* toKeys = scratchKeys.data();
+            uint32_t* toValues = scratchValues.data();
+            for (size_t i = 0; i < n; i++)
+            {
+                uint64_t key = fromKeys[i];
+                uint32_t to = count[(key >> shift) & (RENDER_QUEUE_BUCKETS - 1)]++;
+                toKeys[to] = key;
+                toValues[to] = fromValues[i];
+            }
+            keys.swap(scratchKeys);
+            values.swap(scratchValues);
+        }
+    }
+
+private:
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> values;
+    std::vector<uint64_t> scratchKeys;   // Ping-pong targets of the digit passes
+    std::vector<uint32_t> scratchValues;
+    std::vector<uint32_t> histograms;
+};
+
+#endif
@@ -0,0 +1,283 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Text scene description, one statement per line. Everything after '#' is a comment.
+ *
+ *   texture <name> <path> [matte|unlit]          declares a texture; files shared by several names load once.
+ *                                                Surfaces are lit with specular highlights unless marked matte
+ *                                                (diffuse only) or unlit (the texture as is)
+ *   group <name> <x> <y> <z>                     offsets everything up to the matching 'end', groups nest
+ *   end
+ *   cube <x> <y> <z> <w> <h> <l> <texture> [occluder]
+ *                                                occluder cubes hide what is behind them from the software
+ *                                                occlusion test, mark only large ones
+ *   pyramid <x> <y> <z> <w> <h> <l> <texture>
+ *   cylinder <x> <y> <z> <r> <h> <texture> [edges] [capped 0|1] [lods]
+ *   plane <x1> <y1> <z1> ... <x4> <y4> <z4> <texture>   corners 1 and 3 are opposite
+ *   model <path> <x> <y> <z> [scale] [lods]      imports an .obj or .glb file with its own textures; each mesh
+ *                                                gets lods levels of detail, the full one and simplified ones
+ *
+ * Primitives refer to textures by index into Scene::textures, which holds each file exactly once.
+ */
+
+enum SceneLighting : unsigned int
+{
+    SCENE_LIGHTING_PHONG = 0,
+    SCENE_LIGHTING_MATTE,
+    SCENE_LIGHTING_UNLIT
+};
+
+struct SceneBox
+{
+    glm::vec3 position;
+    glm::vec3 size;
+    unsigned int texture;
+    bool occluder;
+};
+
+struct SceneCylinder
+{
+    glm::vec3 position;
+    float radius, height;
+    unsigned int texture;
+    unsigned int edges;
+    bool capped;
+    unsigned int lods;
+};
+
+struct ScenePlane
+{
+    glm::vec3 corners[4];
+    unsigned int texture;
+};
+
+struct SceneModel
+{
+    std::string path;
+    glm::vec3 position;
+    float scale;
+    unsigned int lods;
+};
+
+struct Scene
+{
+    std::vector<std::string> textures; // Unique texture files
+    std::vector<SceneLighting> textureLighting; // Lighting of the surfaces using each of textures
+    std::vector<SceneBox> cubes;
+    std::vector<SceneBox> pyramids;
+    std::vector<SceneCylinder> cylinders;
+    std::vector<ScenePlane> planes;
+    std::vector<SceneModel> models;
+};
+
+// Splits a line in place into whitespace separated tokens, stopping at a comment
+inline size_t TokenizeSceneLine(char* line, char** tokens, size_t maxTokens)
+{
+    size_t count = 0;
+    char* cursor = line;
+    while (count < maxTokens)
+    {
+        while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r')
+            cursor++;
+        if (*cursor == '\0' || *cursor == '#')
+            break;
+
+        tokens[count++] = cursor;
+        while (*cursor && *cursor != ' ' && *cursor != '\t' && *cursor != '\r' && *cursor != '#')
+            cursor++;
+        if (*cursor == '#')
+        {
+            *cursor = '\0';
+            break;
+        }
+        if (*cursor)
+            *cursor++ = '\0';
+    }
+    return count;
+}
+
+inline bool ParseSceneFloat(const char* token, float& value)
+{
+    char* end = nullptr;
+    value = strtof(token, &end);
+    return end != token && *end == '\0';
+}
+
+inline bool ParseSceneUnsigned(const char* token, unsigned int& value)
+{
+    char* end = nullptr;
+    value = (unsigned int)strtoul(token, &end, 10);
+    return end != token && *end == '\0';
+}
+
+/* Reads a scene one line at a time, so the whole file is never held in memory.
+ * Group offsets are folded into the primitive positions while parsing.
+ * Reports the first malformed line to cout and returns false.
+ */
+inline bool ParseScene(std::istream& in, Scene& scene)
+{
+    std::unordered_map<std::string, unsigned int> textureNames; // Declared name to index in scene.textures
+    std::unordered_map<std::string, unsigned int> texturePaths; // File path to index in scene.textures
+    std::vector<glm::vec3> groups(1, glm::vec3(0.0f)); // Accumulated offset of each open group
+
+    std::string line;
+    unsigned int lineNumber = 0;
+    char* tokens[16];
+    float values[12];
+
+    auto fail = [&](const char* message)
+    {
+        std::cout << "Scene line " << lineNumber << ": " << message << std::endl;
+        return false;
+    };
+
+    // Parses count numbers starting at tokens[first] into values
+    auto numbers = [&](size_t first, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!ParseSceneFloat(tokens[first + i], values[i]))
+                return false;
+        }
+        return true;
+    };
+
+    auto texture = [&](const char* name, unsigned int& index)
+    {
+        auto found = textureNames.find(name);
+        if (found == textureNames.end())
+            return false;
+        index = found->second;
+        return true;
+    };
+
+    while (std::getline(in, line))
+    {
+        lineNumber++;
+        size_t nTokens = TokenizeSceneLine(&line[0], tokens, sizeof(tokens) / sizeof(tokens[0]));
+        if (nTokens == 0)
+            continue;
+
+        const char* keyword = tokens[0];
+        glm::vec3 offset = groups.back();
+
+        if (strcmp(keyword, "texture") == 0)
+        {
+            SceneLighting lighting = SCENE_LIGHTING_PHONG;
+            if (nTokens == 4 && strcmp(tokens[3], "matte") == 0)
+                lighting = SCENE_LIGHTING_MATTE;
+            else if (nTokens == 4 && strcmp(tokens[3], "unlit") == 0)
+                lighting = SCENE_LIGHTING_UNLIT;
+            else if (nTokens != 3)
+                return fail("expected: texture <name> <path> [matte|unlit]");
+
+            auto path = texturePaths.find(tokens[2]);
+            unsigned int index = 0;
+            if (path != texturePaths.end())
+            {
+                index = path->second;
+                if (scene.textureLighting[index] != lighting)
+                    return fail("texture file already declared with other lighting");
+            }
+            else
+            {
+                index = (unsigned int)scene.textures.size();
+                scene.textures.push_back(tokens[2]);
+                scene.textureLighting.push_back(lighting);
+                texturePaths[tokens[2]] = index;
+            }
+            textureNames[tokens[1]] = index;
+        }
+        else if (strcmp(keyword, "group") == 0)
+        {
+            if (nTokens != 5 || !numbers(2, 3))
+                return fail("expected: group <name> <x> <y> <z>");
+            groups.push_back(offset + glm::vec3(values[0], values[1], values[2]));
+        }
+        else if (strcmp(keyword, "end") == 0)
+        {
+            if (groups.size() == 1)
+                return fail("'end' without a matching group");
+            groups.pop_back();
+        }
+        else if (strcmp(keyword, "cube") == 0 || strcmp(keyword, "pyramid") == 0)
+        {
+            SceneBox box;
+            box.occluder = nTokens == 9 && keyword[0] == 'c' && strcmp(tokens[8], "occluder") == 0;
+            if ((nTokens != 8 && !box.occluder) || !numbers(1, 6))
+                return fail("expected: cube <x> <y> <z> <w> <h> <l> <texture> [occluder] or pyramid <x> <y> <z> <w> <h> <l> <texture>");
+            if (!texture(tokens[7], box.texture))
+                return fail("unknown texture");
+
+            box.position = offset + glm::vec3(values[0], values[1], values[2]);
+            box.size = glm::vec3(values[3], values[4], values[5]);
+            (keyword[0] == 'c' ? scene.cubes : scene.pyramids).push_back(box);
+        }
+        else if (strcmp(keyword, "cylinder") == 0)
+        {
+            SceneCylinder cylinder;
+            cylinder.edges = 32;
+            cylinder.capped = true;
+            cylinder.lods = 3;
+
+            unsigned int capped = 1;
+            if (nTokens < 7 || nTokens > 10 || !numbers(1, 5)
+                || (nTokens > 7 && !ParseSceneUnsigned(tokens[7], cylinder.edges))
+                || (nTokens > 8 && !ParseSceneUnsigned(tokens[8], capped))
+                || (nTokens > 9 && !ParseSceneUnsigned(tokens[9], cylinder.lods)))
+                return fail("expected: cylinder <x> <y> <z> <r> <h> <texture> [edges] [capped] [lods]");
+            if (!texture(tokens[6], cylinder.texture))
+                return fail("unknown texture");
+
+            cylinder.position = offset + glm::vec3(values[0], values[1], values[2]);
+            cylinder.radius = values[3];
+            cylinder.height = values[4];
+            cylinder.capped = capped != 0;
+            scene.cylinders.push_back(cylinder);
+        }
+        else if (strcmp(keyword, "plane") == 0)
+        {
+            ScenePlane plane;
+            if (nTokens != 14 || !numbers(1, 12))
+                return fail("expected: plane <x1> <y1> <z1> ... <x4> <y4> <z4> <texture>");
+            if (!texture(tokens[13], plane.texture))
+                return fail("unknown texture");
+
+            for (int i = 0; i < 4; i++)
+                plane.corners[i] = offset + glm::vec3(values[3 * i], values[3 * i + 1], values[3 * i + 2]);
+            scene.planes.push_back(plane);
+        }
+        else if (strcmp(keyword, "model") == 0)
+        {
+            SceneModel model;
+            model.scale = 1.0f;
+            model.lods = 4;
+            if (nTokens < 5 || nTokens > 7 || !numbers(2, 3)
+                || (nTokens > 5 && !ParseSceneFloat(tokens[5], model.scale))
+                || (nTokens > 6 && !ParseSceneUnsigned(tokens[6], model.lods)))
+                return fail("expected: model <path> <x> <y> <z> [scale] [lods]");
+
+            model.path = tokens[1];
+            model.position = offset + glm::vec3(values[0], values[1], values[2]);
+            scene.models.push_back(model);
+        }
+        else
+            return fail("unknown statement");
+    }
+
+    if (groups.size() != 1)
+        return fail("group is missing its 'end'");
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <string>
+
+/* Mesh shader permutations.
+ * A variant is a bitmask of the features a material needs. Each feature becomes a #define of 0 or 1 injected after
+ * the source's #version line, and the shader tests them in plain if statements the compiler folds away, so every
+ * variant is compiled from the one source with only the work its materials use.
+ */
+
+const unsigned int SHADER_TEXTURED = 1;  // Base color from the texture, otherwise objectColor
+const unsigned int SHADER_LIT = 2;       // Ambient and diffuse lighting, otherwise the base color as is
+const unsigned int SHADER_SPECULAR = 4;  // Specular highlights, only with SHADER_LIT
+const unsigned int SHADER_VARIANTS = 8;
+
+// Drops the features a variant has no use for, so equal shaders get equal masks
+inline unsigned int NormalizeShaderVariant(unsigned int variant)
+{
+    variant &= SHADER_VARIANTS - 1;
+    if (!(variant & SHADER_LIT))
+        variant &= ~SHADER_SPECULAR;
+    return variant;
+}
+
+// The source with prelude after its first line, which must be the #version line
+inline std::string InsertShaderPrelude(const char* source, const std::string& prelude)
+{
+    std::string text(source);
+    std::string::size_type lineEnd = text.find('\n');
+    lineEnd = lineEnd == std::string::npos ? text.size() : lineEnd + 1;
+    return text.insert(lineEnd, prelude);
+}
+
+// The source with the variant's FEATURE_ defines after its #version line
+inline std::string InjectShaderDefines(const char* source, unsigned int variant)
+{
+    const char* features[] = { "FEATURE_TEXTURE", "FEATURE_LIGHTING", "FEATURE_SPECULAR" };
+
+    std::string defines;
+    for (unsigned int i = 0; i < sizeof(features) / sizeof(features[0]); i++)
+        defines += std::string("#define ") + features[i] + ((variant & (1u << i)) ? " 1\n" : " 0\n");
+    return InsertShaderPrelude(source, defines);
+}
+
+#endif
@@ -0,0 +1,408 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include <glm/glm.hpp>
+
+#include <vertex_format.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/* Quadric error metric simplification (Garland and Heckbert) of triangle lists in the full FLOATS_PER_VERTEX layout.
+ * Edges collapse onto one of their existing vertices, so the output indexes the input vertices and no new
+ * vertex data is made. Vertices sharing a position but not their other attributes are wedges of one position;
+ * the position is classified once up front:
+ *
+ *   manifold   one wedge, closed fan                   collapses onto any neighbour
+ *   border     one wedge, one open edge in and out     only slides along its border onto another border vertex
+ *   seam       two wedges, each with one open edge     only slides along the seam, both wedges at once
+ *   locked     anything else                           never moves
+ *
+ * so borders and UV seams keep their shape and the texture does not tear along them.
+ */
+
+enum SimplifyVertexKind : uint8_t
+{
+    SIMPLIFY_MANIFOLD,
+    SIMPLIFY_BORDER,
+    SIMPLIFY_SEAM,
+    SIMPLIFY_LOCKED
+};
+
+const float SIMPLIFY_BORDER_WEIGHT = 10.0f; // Weight of the planes that hold borders in place, relative to the surface
+
+// Symmetric 4x4 plane quadric with the total weight of the planes in it
+struct Quadric
+{
+    double a00 = 0.0, a11 = 0.0, a22 = 0.0, a01 = 0.0, a02 = 0.0, a12 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0, c = 0.0;
+    double weight = 0.0;
+
+    // Adds the plane n.x + d = 0, n unit length
+    void addPlane(const glm::vec3& n, float d, float planeWeight)
+    {
+        a00 += planeWeight * n.x * n.x;
+        a11 += planeWeight * n.y * n.y;
+        a22 += planeWeight * n.z * n.z;
+        a01 += planeWeight * n.x * n.y;
+        a02 += planeWeight * n.x * n.z;
+        a12 += planeWeight * n.y * n.z;
+        b0 += planeWeight * n.x * d;
+        b1 += planeWeight * n.y * d;
+        b2 += planeWeight * n.z * d;
+        c += planeWeight * d * d;
+        weight += planeWeight;
+    }
+
+    void add(const Quadric& other)
+    {
+        a00 += other.a00; a11 += other.a11; a22 += other.a22;
+        a01 += other.a01; a02 += other.a02; a12 += other.a12;
+        b0 += other.b0; b1 += other.b1; b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+    }
+
+    // Weighted mean squared distance of p from the planes
+    float error(const glm::vec3& p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double r = a00 * x * x + a11 * y * y + a22 * z * z
+                 + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                 + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return weight > 0.0 ? (float)(std::fabs(r) / weight) : 0.0f;
+    }
+};
+
+/* Simplifies a triangle list until at most targetIndexCount indices remain or nothing more can collapse.
+ * Writes the surviving triangles to output and returns the largest collapse error as a distance in the
+ * units of the positions, which is what USelectLod compares against the screen.
+ */
+inline float SimplifyMesh(const float* vertices, size_t nVertices, const uint32_t* indices, size_t nIndices,
+    size_t targetIndexCount, std::vector<uint32_t>& output)
+{
+    output.assign(indices, indices + nIndices - nIndices % 3);
+    if (nVertices == 0 || output.size() <= targetIndexCount)
+        return 0.0f;
+
+    auto position = [&](uint32_t v) { return glm::vec3(vertices[v * FLOATS_PER_VERTEX], vertices[v * FLOATS_PER_VERTEX + 1], vertices[v * FLOATS_PER_VERTEX + 2]); };
+    auto edgeKey = [](uint32_t a, uint32_t b) { return ((uint64_t)a << 32) | b; };
+
+    // Wedges: every vertex maps to the first vertex with its position, and the wedges of a position form a ring
+    struct PositionHash
+    {
+        size_t operator()(const glm::vec3& p) const
+        {
+            uint32_t words[3];
+            memcpy(words, &p, sizeof(words));
+            return (size_t)((words[0] * 73856093u) ^ (words[1] * 19349663u) ^ (words[2] * 83492791u));
+        }
+    };
+    struct PositionEqual // Bitwise, to agree with the hash
+    {
+        bool operator()(const glm::vec3& a, const glm::vec3& b) const { return memcmp(&a, &b, sizeof(a)) == 0; }
+    };
+    std::vector<uint32_t> remap(nVertices);
+    std::vector<uint32_t> wedge(nVertices);
+    {
+        std::unordered_map<glm::vec3, uint32_t, PositionHash, PositionEqual> firstWithPosition;
+        firstWithPosition.reserve(nVertices);
+        for (uint32_t v = 0; v < nVertices; v++)
+        {
+            auto inserted = firstWithPosition.emplace(position(v), v);
+            uint32_t first = inserted.first->second;
+            remap[v] = first;
+            wedge[v] = v;
+            if (first != v)
+            {
+                wedge[v] = wedge[first];
+                wedge[first] = v;
+            }
+        }
+    }
+
+    // Directed edges by vertex and by position; an edge is open when its reverse is missing
+    std::unordered_set<uint64_t> vertexEdges, positionEdges;
+    vertexEdges.reserve(output.size());
+    positionEdges.reserve(output.size());
+    for (size_t i = 0; i < output.size(); i += 3)
+    {
+        for (int e = 0; e < 3; e++)
+        {
+            uint32_t a = output[i + e], b = output[i + (e + 1) % 3];
+            vertexEdges.insert(edgeKey(a, b));
+            positionEdges.insert(edgeKey(remap[a], remap[b]));
+        }
+    }
+
+    const uint32_t none = 0xffffffff;
+    std::vector<uint32_t> openOut(nVertices, none), openIn(nVertices, none);
+    std::vector<uint8_t> openOutCount(nVertices, 0), openInCount(nVertices, 0);
+    std::vector<uint8_t> positionOpen(nVertices, 0);
+    for (size_t i = 0; i < output.size(); i += 3)
+    {
+        for (int e = 0; e < 3; e++)
+        {
+            uint32_t a = output[i + e], b = output[i + (e + 1) % 3];
+            if (!vertexEdges.count(edgeKey(b, a)))
+            {
+                openOut[a] = b;
+                openIn[b] = a;
+                openOutCount[a] = (uint8_t)std::min(openOutCount[a] + 1, 255);
+                openInCount[b] = (uint8_t)std::min(openInCount[b] + 1, 255);
+            }
+            if (!positionEdges.count(edgeKey(remap[b], remap[a])))
+                positionOpen[remap[a]] = positionOpen[remap[b]] = 1;
+        }
+    }
+
+    std::vector<uint8_t> kind(nVertices, SIMPLIFY_LOCKED);
+    for (uint32_t v = 0; v < nVertices; v++)
+    {
+        if (remap[v] != v)
+            continue;
+
+        uint32_t other = wedge[v];
+        if (other == v)
+        {
+            if (openOutCount[v] == 0 && openInCount[v] == 0)
+                kind[v] = SIMPLIFY_MANIFOLD;
+            else if (openOutCount[v] == 1 && openInCount[v] == 1)
+                kind[v] = SIMPLIFY_BORDER;
+        }
+        else if (wedge[other] == v && !positionOpen[v]
+            && openOutCount[v] == 1 && openInCount[v] == 1 && openOutCount[other] == 1 && openInCount[other] == 1)
+            kind[v] = SIMPLIFY_SEAM;
+    }
+    for (uint32_t v = 0; v < nVertices; v++)
+        kind[v] = kind[remap[v]];
+
+    // Surface planes weighted by area, plus planes through each open edge that keep borders and seams in place
+    std::vector<Quadric> quadrics(nVertices);
+    for (size_t i = 0; i < output.size(); i += 3)
+    {
+        uint32_t corners[3] = { output[i], output[i + 1], output[i + 2] };
+        glm::vec3 p[3] = { position(corners[0]), position(corners[1]), position(corners[2]) };
+        glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+        float area = glm::length(normal);
+        if (area == 0.0f)
+            continue;
+        normal /= area;
+
+        for (int e = 0; e < 3; e++)
+            quadrics[remap[corners[e]]].addPlane(normal, -glm::dot(normal, p[0]), area);
+
+        for (int e = 0; e < 3; e++)
+        {
+            uint32_t a = corners[e], b = corners[(e + 1) % 3];
+            bool border = !positionEdges.count(edgeKey(remap[b], remap[a]));
+            bool seam = !border && !vertexEdges.count(edgeKey(b, a));
+            if (!border && !seam)
+                continue;
+
+            glm::vec3 edge = p[(e + 1) % 3] - p[e];
+            glm::vec3 edgeNormal = glm::cross(edge, normal);
+            float length = glm::length(edgeNormal);
+            if (length == 0.0f)
+                continue;
+            edgeNormal /= length;
+            float edgeWeight = glm::dot(edge, edge) * (border ? SIMPLIFY_BORDER_WEIGHT : 1.0f);
+            quadrics[remap[a]].addPlane(edgeNormal, -glm::dot(edgeNormal, p[e]), edgeWeight);
+            quadrics[remap[b]].addPlane(edgeNormal, -glm::dot(edgeNormal, p[e]), edgeWeight);
+        }
+    }
+
+    // The other wedge of a seam vertex that slides along with it, none when the collapse is not allowed
+    auto seamPartner = [&](uint32_t v0, uint32_t v1)
+    {
+        uint32_t s0 = wedge[v0], s1 = wedge[v1];
+        if (openOut[s0] == s1 || openIn[s0] == s1)
+            return s1;
+        return none;
+    };
+
+    auto canCollapse = [&](uint32_t v0, uint32_t v1)
+    {
+        if (remap[v0] == remap[v1])
+            return false;
+        switch (kind[v0])
+        {
+        case SIMPLIFY_MANIFOLD:
+            return true;
+        case SIMPLIFY_BORDER:
+            return kind[v1] == SIMPLIFY_BORDER && (openOut[v0] == v1 || openIn[v0] == v1);
+        case SIMPLIFY_SEAM:
+            return kind[v1] == SIMPLIFY_SEAM && (openOut[v0] == v1 || openIn[v0] == v1) && seamPartner(v0, v1) != none;
+        default:
+            return false;
+        }
+    };
+
+    struct Collapse
+    {
+        uint32_t v0, v1;
+        float error;
+    };
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> collapseOrder;
+    std::vector<uint32_t> collapseRemap(nVertices);
+    std::vector<char> collapseLocked(nVertices);
+    std::vector<uint32_t> adjacencyOffset(nVertices + 1), adjacency;
+    float maxError = 0.0f;
+    bool uncapped = false;
+
+    while (output.size() > targetIndexCount)
+    {
+        // Triangles around each position, for the flip test
+        std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+        for (uint32_t index : output)
+            adjacencyOffset[remap[index] + 1]++;
+        for (size_t v = 0; v < nVertices; v++)
+            adjacencyOffset[v + 1] += adjacencyOffset[v];
+        adjacency.resize(output.size());
+        {
+            std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+            for (size_t i = 0; i < output.size(); i++)
+                adjacency[fill[remap[output[i]]]++] = (uint32_t)(i / 3);
+        }
+
+        // Each edge is a candidate in whichever allowed direction costs less
+        collapses.clear();
+        for (size_t i = 0; i < output.size(); i += 3)
+        {
+            for (int e = 0; e < 3; e++)
+            {
+                uint32_t a = output[i + e], b = output[i + (e + 1) % 3];
+                if (remap[a] > remap[b] && openOut[a] != b)
+                    continue; // Closed edge, the other triangle of the edge adds it
+
+                bool forward = canCollapse(a, b), backward = canCollapse(b, a);
+                if (!forward && !backward)
+                    continue;
+                float forwardError = forward ? quadrics[remap[a]].error(position(b)) : FLT_MAX;
+                float backwardError = backward ? quadrics[remap[b]].error(position(a)) : FLT_MAX;
+                if (forwardError <= backwardError)
+                    collapses.push_back({ a, b, forwardError });
+                else
+                    collapses.push_back({ b, a, backwardError });
+            }
+        }
+        if (collapses.empty())
+            break;
+
+        collapseOrder.resize(collapses.size());
+        for (size_t c = 0; c < collapses.size(); c++)
+            collapseOrder[c] = (uint32_t)c;
+        std::sort(collapseOrder.begin(), collapseOrder.end(), [&](uint32_t a, uint32_t b) { return collapses[a].error < collapses[b].error; });
+
+        // A manifold collapse removes about two triangles; the pass stops once the goal is met and skips
+        // collapses well above the cheapest ones that would meet it, so cheap collapses happen first across
+        // the whole mesh. When everything under the cap is blocked the pass is retried without one.
+        size_t triangleGoal = (output.size() - targetIndexCount) / 3;
+        float errorCap = uncapped ? FLT_MAX : collapses[collapseOrder[std::min(collapseOrder.size() - 1, triangleGoal / 2)]].error * 1.5f;
+
+        for (uint32_t v = 0; v < nVertices; v++)
+            collapseRemap[v] = v;
+        std::fill(collapseLocked.begin(), collapseLocked.end(), 0);
+        size_t trianglesRemoved = 0;
+        size_t nCollapsed = 0;
+
+        for (uint32_t c : collapseOrder)
+        {
+            const Collapse& collapse = collapses[c];
+            if (trianglesRemoved >= triangleGoal || collapse.error > errorCap)
+                break;
+
+            uint32_t v0 = collapse.v0, v1 = collapse.v1;
+            uint32_t r0 = remap[v0], r1 = remap[v1];
+            if (collapseLocked[r0] || collapseLocked[r1])
+                continue;
+
+            // Moving r0 onto r1 must not turn any remaining triangle around r0 over. Corners go through
+            // collapseRemap first, so neighbours that already collapsed this pass are tested where they ended up.
+            glm::vec3 target = position(v1);
+            bool flips = false;
+            for (uint32_t a = adjacencyOffset[r0]; a < adjacencyOffset[r0 + 1] && !flips; a++)
+            {
+                const uint32_t* corners = &output[adjacency[a] * 3];
+                uint32_t triangle[3] = { collapseRemap[corners[0]], collapseRemap[corners[1]], collapseRemap[corners[2]] };
+                uint32_t r[3] = { remap[triangle[0]], remap[triangle[1]], remap[triangle[2]] };
+                if (r[0] == r1 || r[1] == r1 || r[2] == r1)
+                    continue;
+                if (r[0] == r[1] || r[1] == r[2] || r[0] == r[2])
+                    continue; // Already collapsed to a line, dropped after the pass
+
+                glm::vec3 p[3] = { position(triangle[0]), position(triangle[1]), position(triangle[2]) };
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                for (int k = 0; k < 3; k++)
+                {
+                    if (r[k] == r0)
+                        p[k] = target;
+                }
+                glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+                flips = glm::dot(before, after) <= 0.0f;
+            }
+            if (flips)
+                continue;
+
+            // Sliding along an open edge, the open edge on v0's far side becomes v1's
+            auto slide = [&](uint32_t from, uint32_t to)
+            {
+                collapseRemap[from] = to;
+                if (openOut[from] == to)
+                    openIn[to] = openIn[from];
+                else if (openIn[from] == to)
+                    openOut[to] = openOut[from];
+            };
+            if (kind[v0] == SIMPLIFY_SEAM)
+                slide(wedge[v0], seamPartner(v0, v1));
+            slide(v0, v1);
+
+            quadrics[r1].add(quadrics[r0]);
+            collapseLocked[r0] = collapseLocked[r1] = 1;
+            trianglesRemoved += kind[v0] == SIMPLIFY_BORDER ? 1 : 2;
+            maxError = std::max(maxError, collapse.error);
+            nCollapsed++;
+        }
+        if (nCollapsed == 0)
+        {
+            if (uncapped)
+                break;
+            uncapped = true;
+            continue;
+        }
+        uncapped = false;
+
+        // Drop the triangles that collapsed to a line; the survivors keep their open edges, so the
+        // classification still holds for the next pass
+        size_t write = 0;
+        for (size_t i = 0; i < output.size(); i += 3)
+        {
+            uint32_t a = collapseRemap[output[i]], b = collapseRemap[output[i + 1]], d = collapseRemap[output[i + 2]];
+            if (remap[a] == remap[b] || remap[b] == remap[d] || remap[a] == remap[d])
+                continue;
+            output[write++] = a;
+            output[write++] = b;
+            output[write++] = d;
+        }
+        output.resize(write);
+
+        for (uint32_t v = 0; v < nVertices; v++)
+        {
+            if (openOut[v] != none)
+                openOut[v] = collapseRemap[openOut[v]];
+            if (openIn[v] != none)
+                openIn[v] = collapseRemap[openIn[v]];
+        }
+    }
+
+    return std::sqrt(maxError);
+}
+
+#endif
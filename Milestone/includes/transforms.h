@@ -0,0 +1,87 @@
+#ifndef TRANSFORMS_H
+#define TRANSFORMS_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TRANSFORMS_SSE
+#include <xmmintrin.h>
+#endif
+
+/* Per-object transforms for the vertex shaders.
+ * The normal matrix is the inverse transpose of the model matrix's upper 3x3. Its columns are the cross products of
+ * the 3x3's columns over its determinant, which the SSE path works out for four objects at once, one object per lane,
+ * instead of every vertex inverting a 4x4.
+ */
+
+struct ObjectTransform // std430 layout of one entry of the vertex shaders' Objects buffer
+{
+    glm::mat4 model;
+    glm::vec4 normal[3];  // Normal matrix columns, w unused
+};
+static_assert(sizeof(ObjectTransform) == 112, "ObjectTransform must match the std430 ObjectData struct");
+
+// One object's normal matrix, the scalar path and the SSE path's leftovers
+inline void ComputeNormalMatrix(const glm::mat4& model, glm::vec4 normal[3])
+{
+    glm::vec3 c0(model[0]), c1(model[1]), c2(model[2]);
+    glm::vec3 n0 = glm::cross(c1, c2), n1 = glm::cross(c2, c0), n2 = glm::cross(c0, c1);
+    float inverseDeterminant = 1.0f / glm::dot(c0, n0);
+    normal[0] = glm::vec4(n0 * inverseDeterminant, 0.0f);
+    normal[1] = glm::vec4(n1 * inverseDeterminant, 0.0f);
+    normal[2] = glm::vec4(n2 * inverseDeterminant, 0.0f);
+}
+
+// Fills out[i] with models[i] and its normal matrix, for i below n
+inline void ComputeObjectTransforms(const glm::mat4* models, ObjectTransform* out, size_t n)
+{
+    size_t i = 0;
+
+#ifdef TRANSFORMS_SSE
+    for (; i + 4 <= n; i += 4)
+    {
+        // m[c][r] holds element r of column c of the four models
+        __m128 m[3][3];
+        for (int c = 0; c < 3; c++)
+        {
+            for (int r = 0; r < 3; r++)
+                m[c][r] = _mm_setr_ps(models[i][c][r], models[i + 1][c][r], models[i + 2][c][r], models[i + 3][c][r]);
+        }
+
+        // n[k] = cross(column k + 1, column k + 2)
+        __m128 cofactor[3][3];
+        for (int k = 0; k < 3; k++)
+        {
+            const __m128* a = m[(k + 1) % 3];
+            const __m128* b = m[(k + 2) % 3];
+            cofactor[k][0] = _mm_sub_ps(_mm_mul_ps(a[1], b[2]), _mm_mul_ps(a[2], b[1]));
+            cofactor[k][1] = _mm_sub_ps(_mm_mul_ps(a[2], b[0]), _mm_mul_ps(a[0], b[2]));
+            cofactor[k][2] = _mm_sub_ps(_mm_mul_ps(a[0], b[1]), _mm_mul_ps(a[1], b[0]));
+        }
+        __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][0], cofactor[0][0]), _mm_mul_ps(m[0][1], cofactor[0][1])),
+                                        _mm_mul_ps(m[0][2], cofactor[0][2]));
+        __m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+        for (int k = 0; k < 3; k++)
+        {
+            alignas(16) float column[3][4];
+            for (int r = 0; r < 3; r++)
+                _mm_store_ps(column[r], _mm_mul_ps(cofactor[k][r], inverseDeterminant));
+            for (int lane = 0; lane < 4; lane++)
+                out[i + lane].normal[k] = glm::vec4(column[0][lane], column[1][lane], column[2][lane], 0.0f);
+        }
+        for (int lane = 0; lane < 4; lane++)
+            out[i + lane].model = models[i + lane];
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+        out[i].model = models[i];
+        ComputeNormalMatrix(models[i], out[i].normal);
+    }
+}
+
+#endif
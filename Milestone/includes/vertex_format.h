@@ -0,0 +1,101 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+// Full vertex layout: 3 position, 3 normal, 2 texture coordinate floats (32 bytes)
+constexpr unsigned int FLOATS_PER_VERTEX = 3 + 3 + 2;
+
+// Compact vertex layout (16 bytes). The vertex shader rebuilds the position from the mesh bounds.
+struct PackedVertex
+{
+    uint16_t position[4]; // x, y, z quantized across the mesh bounds, w is padding
+    uint32_t normal;      // GL_INT_2_10_10_10_REV, signed normalized
+    uint16_t uv[2];       // half floats
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must stay 16 bytes");
+
+// Converts a float to an IEEE half float, rounding to nearest even
+inline uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    // Infinity and NaN
+    if (((bits >> 23) & 0xff) == 0xff)
+        return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+    // Too large for a half, clamp to infinity
+    if (exponent >= 31)
+        return (uint16_t)(sign | 0x7c00);
+
+    // Subnormal half or zero
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+            return (uint16_t)sign;
+
+        mantissa |= 0x800000;
+        uint32_t shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1)))
+            half++;
+        return (uint16_t)(sign | half);
+    }
+
+    // A carry out of the mantissa correctly bumps the exponent
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        half++;
+    return (uint16_t)(sign | half);
+}
+
+// Packs a unit normal into the x, y, z fields of a signed 2_10_10_10 word
+inline uint32_t PackNormal(const glm::vec3& normal)
+{
+    uint32_t packed = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        float clamped = fminf(fmaxf(normal[i], -1.0f), 1.0f);
+        int32_t component = (int32_t)lroundf(clamped * 511.0f);
+        packed |= ((uint32_t)component & 0x3ff) << (10 * i);
+    }
+    return packed;
+}
+
+// Maps a coordinate inside [lo, lo + extent] to the full unsigned 16 bit range
+inline uint16_t QuantizeUnorm16(float value, float lo, float extent)
+{
+    if (extent <= 0.0f)
+        return 0;
+
+    float t = (value - lo) / extent;
+    t = fminf(fmaxf(t, 0.0f), 1.0f);
+    return (uint16_t)lroundf(t * 65535.0f);
+}
+
+// Packs one full vertex (FLOATS_PER_VERTEX floats) against the bounds of its mesh
+inline PackedVertex PackVertex(const float* vert, const glm::vec3& boundsMin, const glm::vec3& boundsExtent)
+{
+    PackedVertex packed;
+    for (int i = 0; i < 3; i++)
+        packed.position[i] = QuantizeUnorm16(vert[i], boundsMin[i], boundsExtent[i]);
+    packed.position[3] = 0;
+    packed.normal = PackNormal(glm::vec3(vert[3], vert[4], vert[5]));
+    packed.uv[0] = FloatToHalf(vert[6]);
+    packed.uv[1] = FloatToHalf(vert[7]);
+    return packed;
+}
+
+#endif